@@ -0,0 +1,1141 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "linked_list_hashmap.h"
+#include "concurrent_hashmap.h"
+#include "hashmap_hashes.h"
+#include "hashmap_template.h"
+#include "hashmap_uint.h"
+#include "hashmap_snapshot.h"
+#include "hashmap_stream.h"
+#include "hashmap_parallel.h"
+
+static unsigned long __hash_calls;
+
+static double __now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* FNV-1a, counted so that we can see how often the map re-hashes */
+static unsigned long __str_hash(
+    const void *e1
+    )
+{
+    const unsigned char *s = e1;
+    unsigned long h = 14695981039346656037UL;
+
+    __hash_calls++;
+    while (*s)
+        h = (h ^ *s++) * 1099511628211UL;
+    return h;
+}
+
+/* the built-in string hash, counted the same way */
+static unsigned long __builtin_str_hash(
+    const void *e1
+    )
+{
+    __hash_calls++;
+    return hashmap_str_hash(e1);
+}
+
+HASHMAP_INIT(u64map, uint64_t, uint64_t, hashmap_tpl_hash_u64, HASHMAP_TPL_EQ)
+
+static long __str_compare(
+    const void *e1,
+    const void *e2
+    )
+{
+    return strcmp(e1, e2);
+}
+
+static unsigned long __uint_hash(
+    const void *e1
+    )
+{
+    __hash_calls++;
+    return (unsigned long)e1;
+}
+
+static long __uint_compare(
+    const void *e1,
+    const void *e2
+    )
+{
+    return (unsigned long)e1 - (unsigned long)e2;
+}
+
+static char **__make_keys(size_t n, const char *prefix)
+{
+    char **keys = malloc(n * sizeof(char*));
+    size_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        keys[i] = malloc(32);
+        snprintf(keys[i], 32, "%s:%zu", prefix, i);
+    }
+    return keys;
+}
+
+static void __free_keys(char **keys, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        free(keys[i]);
+    free(keys);
+}
+
+static void __report(const char *name, size_t ops, double secs)
+{
+    printf("%-24s %10zu ops %10.1f ns/op %12lu hash calls\n",
+           name, ops, secs * 1e9 / ops, __hash_calls);
+}
+
+/**
+ * @return peak resident set size in bytes */
+static size_t __peak_rss(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return (size_t)ru.ru_maxrss * 1024;
+}
+
+static void bench_strings(size_t n, func_longhash_f hash)
+{
+    hashmap_t *hm;
+    char **keys = __make_keys(n, "key"), **misses = __make_keys(n, "miss");
+    size_t i;
+    double t;
+
+    hm = hashmap_new(hash, __str_compare, 11);
+
+    __hash_calls = 0;
+    t = __now();
+    for (i = 0; i < n; i++)
+        hashmap_put(hm, keys[i], keys[i]);
+    __report("put (with resizes)", n, __now() - t);
+
+    __hash_calls = 0;
+    t = __now();
+    hashmap_increase_capacity(hm, 2);
+    __report("resize x2", hashmap_count(hm), __now() - t);
+
+    __hash_calls = 0;
+    t = __now();
+    for (i = 0; i < n; i++)
+        if (!hashmap_get(hm, keys[i]))
+            abort();
+    __report("get hit", n, __now() - t);
+
+    __hash_calls = 0;
+    t = __now();
+    for (i = 0; i < n; i++)
+        if (hashmap_get(hm, misses[i]))
+            abort();
+    __report("get miss", n, __now() - t);
+
+    hashmap_freeall(hm);
+    __free_keys(keys, n);
+    __free_keys(misses, n);
+}
+
+/**
+ * Hash keys of each length over and over, with FNV-1a and with
+ * hashmap_hash_bytes. */
+static void bench_hashes(void)
+{
+    static const size_t lens[] = { 4, 8, 16, 32, 64, 256, 1024, 65536 };
+    unsigned char *buf = malloc(65536);
+    unsigned int l;
+    size_t i;
+
+    for (i = 0; i < 65536; i++)
+        buf[i] = 'a' + i % 26;
+
+    printf("%-8s %14s %14s\n", "bytes", "fnv1a GB/s", "builtin GB/s");
+    for (l = 0; l < sizeof(lens) / sizeof(lens[0]); l++)
+    {
+        size_t len = lens[l], reps = (1 << 28) / len + 1000;
+        volatile unsigned long sink = 0;
+        double t, fnv, builtin;
+
+        t = __now();
+        for (i = 0; i < reps; i++)
+        {
+            unsigned long h = 14695981039346656037UL;
+            size_t j;
+
+            /* vary the key so the work can't be hoisted out of the loop */
+            buf[0] = i;
+            for (j = 0; j < len; j++)
+                h = (h ^ buf[j]) * 1099511628211UL;
+            sink += h;
+        }
+        fnv = (double)reps * len / (__now() - t) / 1e9;
+
+        t = __now();
+        for (i = 0; i < reps; i++)
+        {
+            buf[0] = i;
+            sink += hashmap_hash_bytes(buf, len, 0);
+        }
+        builtin = (double)reps * len / (__now() - t) / 1e9;
+
+        printf("%-8zu %14.2f %14.2f\n", len, fnv, builtin);
+    }
+    free(buf);
+}
+
+/**
+ * Integer keys with the identity hash.
+ * @param stride : distance between keys */
+static void bench_ints(size_t n, unsigned long stride, int flags)
+{
+    hashmap_t *hm;
+    unsigned long i;
+    double t;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 11, flags);
+
+    __hash_calls = 0;
+    t = __now();
+    for (i = 1; i <= n; i++)
+        hashmap_put(hm, (void*)(i * stride), (void*)i);
+    __report("put (with resizes)", n, __now() - t);
+
+    __hash_calls = 0;
+    t = __now();
+    for (i = 1; i <= n; i++)
+        if (!hashmap_get(hm, (void*)(i * stride)))
+            abort();
+    __report("get hit", n, __now() - t);
+
+    __hash_calls = 0;
+    t = __now();
+    for (i = 1; i <= n; i++)
+        if (hashmap_get(hm, (void*)((n + i) * stride)))
+            abort();
+    __report("get miss", n, __now() - t);
+
+    hashmap_freeall(hm);
+}
+
+/**
+ * @return n distinct, non-zero pseudo-random keys */
+static unsigned long *__random_keys(size_t n, unsigned long seed)
+{
+    unsigned long *keys = malloc(n * sizeof(unsigned long));
+    size_t i;
+
+    /* an odd multiplier is a bijection, so keys never repeat */
+    for (i = 0; i < n; i++)
+        keys[i] = ((i + seed) * 0x9e3779b97f4a7c15UL) | 1UL << 63;
+    return keys;
+}
+
+/**
+ * Hits, misses and remove/put churn on random integer keys. */
+static void bench_backend(size_t n, int flags)
+{
+    hashmap_t *hm;
+    unsigned long *keys = __random_keys(n * 2, 1);
+    size_t i;
+    double t;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 11, flags);
+
+    __hash_calls = 0;
+    t = __now();
+    for (i = 0; i < n; i++)
+        hashmap_put(hm, (void*)keys[i], (void*)keys[i]);
+    __report("put (with resizes)", n, __now() - t);
+
+    __hash_calls = 0;
+    t = __now();
+    for (i = 0; i < n; i++)
+        if (!hashmap_get(hm, (void*)keys[i]))
+            abort();
+    __report("get hit", n, __now() - t);
+
+    __hash_calls = 0;
+    t = __now();
+    for (i = n; i < n * 2; i++)
+        if (hashmap_get(hm, (void*)keys[i]))
+            abort();
+    __report("get miss", n, __now() - t);
+
+    /* every round swaps one key out for a new one */
+    __hash_calls = 0;
+    t = __now();
+    for (i = 0; i < n; i++)
+    {
+        hashmap_remove(hm, (void*)keys[i]);
+        hashmap_put(hm, (void*)keys[n + i], (void*)keys[n + i]);
+    }
+    __report("remove + put", n, __now() - t);
+
+    hashmap_freeall(hm);
+    free(keys);
+}
+
+/**
+ * Look random keys up in batches of 256, one hashmap_get at a time and
+ * then with hashmap_get_many. */
+static void bench_get_many(size_t n, int flags)
+{
+    hashmap_t *hm;
+    unsigned long *keys = __random_keys(n, 1);
+    void *vals[256];
+    size_t i, j;
+    double t;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 11, flags);
+    for (i = 0; i < n; i++)
+        hashmap_put(hm, (void*)keys[i], (void*)keys[i]);
+
+    /* visit the keys in a different order to how they went in */
+    for (i = 0; i < n; i++)
+    {
+        unsigned long tmp = keys[i];
+        j = (i * 0x9e3779b97f4a7c15UL >> 7) % n;
+        keys[i] = keys[j];
+        keys[j] = tmp;
+    }
+
+    __hash_calls = 0;
+    t = __now();
+    for (i = 0; i + 256 <= n; i += 256)
+        for (j = 0; j < 256; j++)
+            if (!(vals[j] = hashmap_get(hm, (void*)keys[i + j])))
+                abort();
+    __report("get x256", i, __now() - t);
+
+    __hash_calls = 0;
+    t = __now();
+    for (i = 0; i + 256 <= n; i += 256)
+    {
+        hashmap_get_many(hm, (const void**)&keys[i], vals, 256);
+        for (j = 0; j < 256; j++)
+            if (!vals[j])
+                abort();
+    }
+    __report("get_many x256", i, __now() - t);
+
+    hashmap_freeall(hm);
+    free(keys);
+}
+
+/**
+ * bench_backend's workload on a map generated by hashmap_template.h, where
+ * the hash and compare get inlined. */
+static void bench_template(size_t n)
+{
+    u64map_t *hm;
+    unsigned long *keys = __random_keys(n * 2, 1);
+    size_t i;
+    double t;
+
+    hm = u64map_new(0);
+
+    __hash_calls = 0;
+    t = __now();
+    for (i = 0; i < n; i++)
+        u64map_put(hm, keys[i], keys[i]);
+    __report("put (with resizes)", n, __now() - t);
+
+    t = __now();
+    for (i = 0; i < n; i++)
+        if (!u64map_get(hm, keys[i]))
+            abort();
+    __report("get hit", n, __now() - t);
+
+    t = __now();
+    for (i = n; i < n * 2; i++)
+        if (u64map_get(hm, keys[i]))
+            abort();
+    __report("get miss", n, __now() - t);
+
+    t = __now();
+    for (i = 0; i < n; i++)
+    {
+        u64map_remove(hm, keys[i], NULL);
+        u64map_put(hm, keys[n + i], keys[n + i]);
+    }
+    __report("remove + put", n, __now() - t);
+
+    u64map_freeall(hm);
+    free(keys);
+}
+
+/**
+ * Integer keys and values that may be zero: boxed on the heap for a
+ * hashmap_t, against held by value in a hashmap_uint_t. */
+static void bench_uint(size_t n)
+{
+    hashmap_t *hm;
+    hashmap_uint_t *um;
+    unsigned long *keys = __random_keys(n, 1);
+    uint64_t **boxes = malloc(n * sizeof(uint64_t*));
+    size_t i;
+    double t;
+
+    hm = hashmap_new_with_flags(hashmap_u64_hash, hashmap_u64_compare, 11,
+                                HASHMAP_OPEN_ADDRESSING);
+    t = __now();
+    for (i = 0; i < n; i++)
+    {
+        /* key and value share a box */
+        boxes[i] = malloc(sizeof(uint64_t));
+        *boxes[i] = keys[i];
+        hashmap_put(hm, boxes[i], boxes[i]);
+    }
+    __report("boxed put", n, __now() - t);
+
+    t = __now();
+    for (i = 0; i < n; i++)
+    {
+        uint64_t k = keys[i];
+
+        if (k != *(uint64_t*)hashmap_get(hm, &k))
+            abort();
+    }
+    __report("boxed get", n, __now() - t);
+    hashmap_freeall(hm);
+    for (i = 0; i < n; i++)
+        free(boxes[i]);
+
+    um = hashmap_uint_new(0);
+    t = __now();
+    for (i = 0; i < n; i++)
+        hashmap_uint_put(um, keys[i], keys[i]);
+    __report("by value put", n, __now() - t);
+
+    t = __now();
+    for (i = 0; i < n; i++)
+        if (keys[i] != *hashmap_uint_get(um, keys[i]))
+            abort();
+    __report("by value get", n, __now() - t);
+    hashmap_uint_freeall(um);
+
+    free(boxes);
+    free(keys);
+}
+
+/**
+ * Load n random keys into a fresh map, growing as we go and then with
+ * hashmap_reserve. */
+static void bench_reserve(size_t n, int flags)
+{
+    hashmap_t *hm;
+    unsigned long *keys = __random_keys(n, 1);
+    size_t i;
+    double t;
+
+    __hash_calls = 0;
+    t = __now();
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 11, flags);
+    for (i = 0; i < n; i++)
+        hashmap_put(hm, (void*)keys[i], (void*)keys[i]);
+    __report("bulk load", n, __now() - t);
+    hashmap_freeall(hm);
+
+    __hash_calls = 0;
+    t = __now();
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 11, flags);
+    hashmap_reserve(hm, n);
+    for (i = 0; i < n; i++)
+        hashmap_put(hm, (void*)keys[i], (void*)keys[i]);
+    __report("bulk load reserved", n, __now() - t);
+    hashmap_freeall(hm);
+
+    free(keys);
+}
+
+/**
+ * Scan the whole map for its values: a key and then a lookup of that key,
+ * which is what hashmap_iterator_next_value used to cost, against reading
+ * the entry the iterator is already on. */
+static void bench_scan(size_t n, int flags)
+{
+    hashmap_t *hm;
+    hashmap_iterator_t iter;
+    hashmap_entry_t *ety;
+    unsigned long *keys = __random_keys(n, 1), sum = 0;
+    void *key;
+    size_t i;
+    double t;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 11, flags);
+    for (i = 0; i < n; i++)
+        hashmap_put(hm, (void*)keys[i], (void*)keys[i]);
+
+    __hash_calls = 0;
+    t = __now();
+    hashmap_iterator(hm, &iter);
+    while ((key = hashmap_iterator_next(hm, &iter)))
+        sum += (unsigned long)hashmap_get(hm, key);
+    __report("scan next+get", n, __now() - t);
+
+    __hash_calls = 0;
+    t = __now();
+    hashmap_iterator(hm, &iter);
+    while ((ety = hashmap_iterator_next_entry(hm, &iter)))
+        sum -= (unsigned long)ety->val;
+    __report("scan next_entry", n, __now() - t);
+
+    if (0 != sum)
+        abort();
+
+    hashmap_freeall(hm);
+    free(keys);
+}
+
+/* ops each thread does in the multi-threaded benchmarks */
+#define THREAD_OPS 2000000
+
+typedef struct
+{
+    concurrent_hashmap_t *chm;
+    /* used instead of chm if set; guarded by the one big lock */
+    hashmap_t *hm;
+    pthread_mutex_t *lock;
+    size_t nkeys;
+    unsigned long seed;
+} worker_t;
+
+/**
+ * 90% gets and 10% puts over the whole key range. */
+static void *__worker(void *arg)
+{
+    worker_t *w = arg;
+    unsigned long x = w->seed;
+    size_t i;
+
+    for (i = 0; i < THREAD_OPS; i++)
+    {
+        void *key;
+
+        /* xorshift */
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        key = (void*)(1 + x % w->nkeys);
+
+        if (w->hm)
+        {
+            pthread_mutex_lock(w->lock);
+            if (x % 10)
+                hashmap_get(w->hm, key);
+            else
+                hashmap_put(w->hm, key, key);
+            pthread_mutex_unlock(w->lock);
+        }
+        else if (x % 10)
+            concurrent_hashmap_get(w->chm, key);
+        else
+            concurrent_hashmap_put(w->chm, key, key);
+    }
+    return NULL;
+}
+
+/* how bench_threads shares its map */
+enum {
+    /* a hashmap_t behind one mutex */
+    SHARE_MUTEX,
+    /* a concurrent_hashmap_t */
+    SHARE_STRIPED,
+    /* a concurrent_hashmap_t with lock-free gets */
+    SHARE_LOCKFREE,
+};
+
+/**
+ * Threads hammering one map, shared according to mode. */
+static void bench_threads(size_t nkeys, int nthreads, int mode)
+{
+    static const char *names[] = { "mutex", "striped", "lockfree" };
+    concurrent_hashmap_t *chm = NULL;
+    hashmap_t *hm = NULL;
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+    worker_t *workers = malloc(nthreads * sizeof(worker_t));
+    unsigned long i;
+    double t;
+    int j;
+
+    if (SHARE_MUTEX == mode)
+        hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 11,
+                                    HASHMAP_POW2);
+    else
+        chm = concurrent_hashmap_new_with_flags(
+            __uint_hash, __uint_compare, 11, nthreads * 4,
+            SHARE_LOCKFREE == mode ? CONCURRENT_HASHMAP_LOCKFREE_READS : 0);
+    for (i = 1; i <= nkeys; i++)
+        if (hm)
+            hashmap_put(hm, (void*)i, (void*)i);
+        else
+            concurrent_hashmap_put(chm, (void*)i, (void*)i);
+
+    t = __now();
+    for (j = 0; j < nthreads; j++)
+    {
+        workers[j].chm = chm;
+        workers[j].hm = hm;
+        workers[j].lock = &lock;
+        workers[j].nkeys = nkeys;
+        workers[j].seed = 88172645463325252UL + j;
+        pthread_create(&threads[j], NULL, __worker, &workers[j]);
+    }
+    for (j = 0; j < nthreads; j++)
+        pthread_join(threads[j], NULL);
+    t = __now() - t;
+
+    printf("%-10s %2d threads %10.2f Mops/s\n",
+           names[mode], nthreads,
+           (double)THREAD_OPS * nthreads / t / 1e6);
+
+    if (hm)
+        hashmap_freeall(hm);
+    else
+        concurrent_hashmap_freeall(chm);
+    free(threads);
+    free(workers);
+}
+
+static int __cmp_double(const void *a, const void *b)
+{
+    const double x = *(const double*)a, y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Time every put on its own, to see what resizes do to the tail. */
+static void bench_put_latency(size_t n, int flags)
+{
+    hashmap_t *hm;
+    double *lat = malloc(n * sizeof(double)), total = 0;
+    unsigned long i;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 11, flags);
+
+    for (i = 1; i <= n; i++)
+    {
+        double t = __now();
+        hashmap_put(hm, (void*)i, (void*)i);
+        lat[i - 1] = __now() - t;
+        total += lat[i - 1];
+    }
+
+    qsort(lat, n, sizeof(double), __cmp_double);
+    printf("put latency              %10zu ops %10.1f ns/op "
+           "p50 %.0f ns p99 %.0f ns p99.99 %.0f ns max %.0f ns\n",
+           n, total * 1e9 / n, lat[n / 2] * 1e9, lat[n / 100 * 99] * 1e9,
+           lat[n / 10000 * 9999] * 1e9, lat[n - 1] * 1e9);
+
+    hashmap_freeall(hm);
+    free(lat);
+}
+
+/**
+ * Fill a map with tens of millions of integer keys, check every one of
+ * them can be found again and report throughput and memory per entry. */
+static void bench_large(size_t n)
+{
+    hashmap_t *hm;
+    size_t rss = __peak_rss();
+    unsigned long i;
+    double t;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 11,
+                                HASHMAP_POW2);
+
+    t = __now();
+    for (i = 1; i <= n; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    t = __now() - t;
+    printf("put (with resizes)       %10zu ops %10.1f ns/op %10.2f Mops/s\n",
+           n, t * 1e9 / n, n / t / 1e6);
+
+    if (n != hashmap_count(hm))
+        abort();
+
+    t = __now();
+    for (i = 1; i <= n; i++)
+        if (i != (unsigned long)hashmap_get(hm, (void*)i))
+            abort();
+    t = __now() - t;
+    printf("get hit                  %10zu ops %10.1f ns/op %10.2f Mops/s\n",
+           n, t * 1e9 / n, n / t / 1e6);
+
+    printf("array size %zu, peak rss %zu bytes, %.1f bytes/entry\n",
+           hashmap_size(hm), __peak_rss(),
+           (double)(__peak_rss() - rss) / n);
+
+    hashmap_freeall(hm);
+}
+
+/**
+ * Stream a map out to a temporary file and back in.
+ * @param strings : string keys and values, otherwise integers */
+static void bench_stream(size_t n, int strings, int flags)
+{
+    hashmap_stream_encode_f encode = strings ?
+        hashmap_snapshot_encode_str : hashmap_snapshot_encode_uintptr;
+    hashmap_stream_decode_f decode = strings ?
+        hashmap_stream_decode_str : hashmap_stream_decode_uintptr;
+    func_longhash_f hash = strings ? hashmap_str_hash : hashmap_uintptr_hash;
+    func_longcmp_f cmp = strings ? hashmap_str_compare : hashmap_uintptr_compare;
+    char **keys = strings ? __make_keys(n, "key") : NULL;
+    hashmap_iterator_t iter;
+    hashmap_entry_t *ety;
+    hashmap_t *hm;
+    FILE *f = tmpfile();
+    double t, mb;
+    size_t i;
+
+    hm = hashmap_new_with_flags(hash, cmp, 11, HASHMAP_OPEN_ADDRESSING);
+    for (i = 0; i < n; i++)
+        if (strings)
+            hashmap_put(hm, keys[i], keys[i]);
+        else
+            hashmap_put(hm, (void*)(i + 1), (void*)(i + 1));
+
+    t = __now();
+    if (hashmap_stream_write(hm, f, encode, encode, flags) || fflush(f))
+        abort();
+    t = __now() - t;
+    mb = ftell(f) / 1e6;
+    printf("write                    %10.1f MB %10.1f MB/s %10.1f ns/entry\n",
+           mb, mb / t, t * 1e9 / n);
+    hashmap_freeall(hm);
+
+    rewind(f);
+    hm = hashmap_new_with_flags(hash, cmp, 11, HASHMAP_OPEN_ADDRESSING);
+    t = __now();
+    if (hashmap_stream_read(hm, f, decode, decode, NULL) || n != hashmap_count(hm))
+        abort();
+    t = __now() - t;
+    printf("read                     %10.1f MB %10.1f MB/s %10.1f ns/entry\n",
+           mb, mb / t, t * 1e9 / n);
+
+    if (strings)
+    {
+        hashmap_iterator(hm, &iter);
+        while ((ety = hashmap_iterator_next_entry(hm, &iter)))
+        {
+            free((void*)ety->key);
+            free(ety->val);
+        }
+        __free_keys(keys, n);
+    }
+    hashmap_freeall(hm);
+    fclose(f);
+}
+
+static void bench_build(size_t n, int nthreads)
+{
+    unsigned long *keys = __random_keys(n, 1);
+    hashmap_entry_t *entries = malloc(n * sizeof(hashmap_entry_t));
+    hashmap_t *hm;
+    double t, base;
+    size_t i;
+    int th;
+
+    for (i = 0; i < n; i++)
+    {
+        entries[i].key = (void*)keys[i];
+        entries[i].val = (void*)keys[i];
+    }
+
+    t = __now();
+    hm = hashmap_new_with_flags(hashmap_uintptr_hash, hashmap_uintptr_compare,
+                                11, HASHMAP_POW2);
+    hashmap_reserve(hm, n);
+    for (i = 0; i < n; i++)
+        hashmap_put(hm, entries[i].key, entries[i].val);
+    base = __now() - t;
+    printf("reserve + put            %10zu ops %10.1f ns/op\n",
+           n, base * 1e9 / n);
+    hashmap_freeall(hm);
+
+    for (th = 1; th <= nthreads; th *= 2)
+    {
+        char name[32];
+
+        t = __now();
+        hm = hashmap_build_parallel(hashmap_uintptr_hash,
+                                    hashmap_uintptr_compare, entries, n, th, 0);
+        t = __now() - t;
+        if (n != hashmap_count(hm))
+            abort();
+        snprintf(name, sizeof(name), "build, %d threads", th);
+        printf("%-24s %10zu ops %10.1f ns/op %8.2fx\n",
+               name, n, t * 1e9 / n, base / t);
+        hashmap_freeall(hm);
+    }
+
+    free(entries);
+    free(keys);
+}
+
+/* a thread's running total, on its own cache line */
+typedef struct
+{
+    unsigned long sum;
+    char pad[64 - sizeof(unsigned long)];
+} total_t;
+
+static void __add_val(hashmap_entry_t * ety, void *ctx)
+{
+    ((total_t*)ctx)->sum += (unsigned long)ety->val;
+}
+
+static void bench_for_each(size_t n, int nthreads, int flags)
+{
+    unsigned long *keys = __random_keys(n, 1);
+    hashmap_iterator_t iter;
+    hashmap_entry_t *ety;
+    hashmap_t *hm;
+    total_t *totals = calloc(nthreads, sizeof(total_t));
+    void **ctxs = malloc(nthreads * sizeof(void*));
+    unsigned long expected = 0;
+    double t, base;
+    size_t i;
+    int th;
+
+    hm = hashmap_new_with_flags(hashmap_uintptr_hash, hashmap_uintptr_compare,
+                                11, flags);
+    hashmap_reserve(hm, n);
+    for (i = 0; i < n; i++)
+        hashmap_put(hm, (void*)keys[i], (void*)keys[i]);
+    for (i = 0; i < (size_t)nthreads; i++)
+        ctxs[i] = &totals[i];
+
+    t = __now();
+    hashmap_iterator(hm, &iter);
+    while ((ety = hashmap_iterator_next_entry(hm, &iter)))
+        expected += (unsigned long)ety->val;
+    base = __now() - t;
+    printf("iterator                 %10zu ops %10.1f ns/op\n",
+           n, base * 1e9 / n);
+
+    t = __now();
+    totals[0].sum = 0;
+    hashmap_for_each_range(hm, 0, hashmap_range_end(hm), __add_val,
+                           &totals[0]);
+    t = __now() - t;
+    if (expected != totals[0].sum)
+        abort();
+    printf("for_each_range           %10zu ops %10.1f ns/op %8.2fx\n",
+           n, t * 1e9 / n, base / t);
+
+    for (th = 1; th <= nthreads; th *= 2)
+    {
+        char name[32];
+        unsigned long sum = 0;
+
+        memset(totals, 0, nthreads * sizeof(total_t));
+        t = __now();
+        hashmap_for_each_parallel(hm, __add_val, ctxs, th);
+        t = __now() - t;
+        for (i = 0; i < (size_t)th; i++)
+            sum += totals[i].sum;
+        if (expected != sum)
+            abort();
+        snprintf(name, sizeof(name), "for_each, %d threads", th);
+        printf("%-24s %10zu ops %10.1f ns/op %8.2fx\n",
+               name, n, t * 1e9 / n, base / t);
+    }
+
+    hashmap_freeall(hm);
+    free(ctxs);
+    free(totals);
+    free(keys);
+}
+
+/* L1 data cache read misses and last level cache misses */
+#define NCOUNTERS 2
+
+/**
+ * Start counting cache misses on this thread. A counter the kernel or the
+ * hardware won't give us is left as -1. */
+static void __counters_start(int *fds)
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+    int i;
+
+    for (i = 0; i < NCOUNTERS; i++)
+    {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        if (0 == i)
+        {
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D |
+                PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+        }
+        else
+        {
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        }
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    for (i = 0; i < NCOUNTERS; i++)
+        if (-1 != fds[i])
+        {
+            ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#else
+    int i;
+
+    for (i = 0; i < NCOUNTERS; i++)
+        fds[i] = -1;
+#endif
+}
+
+/**
+ * Stop counting, with -1 for a counter we didn't get. */
+static void __counters_stop(int *fds, long long *counts)
+{
+    int i;
+
+    for (i = 0; i < NCOUNTERS; i++)
+    {
+        counts[i] = -1;
+        if (-1 == fds[i])
+            continue;
+#ifdef __linux__
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+#endif
+        if (sizeof(counts[i]) != read(fds[i], &counts[i], sizeof(counts[i])))
+            counts[i] = -1;
+        close(fds[i]);
+    }
+}
+
+static void __print_per_op(long long count, size_t ops)
+{
+    if (-1 == count)
+        printf(" %10s", "n/a");
+    else
+        printf(" %10.2f", (double)count / ops);
+}
+
+/**
+ * Hits on random integer keys in random order, with the cache misses each
+ * one costs. */
+static void bench_cache(size_t n, const char *name, int flags)
+{
+    unsigned long *keys = __random_keys(n, 1);
+    unsigned long x = 88172645463325252UL;
+    hashmap_stats_t stats;
+    hashmap_t *hm;
+    int fds[NCOUNTERS];
+    long long counts[NCOUNTERS];
+    double t;
+    size_t i;
+
+    hm = hashmap_new_with_flags(hashmap_uintptr_hash, hashmap_uintptr_compare,
+                                11, flags);
+    for (i = 0; i < n; i++)
+        hashmap_put(hm, (void*)keys[i], (void*)keys[i]);
+
+    /* so that lookups don't follow the order the entries were put in */
+    for (i = n - 1; 0 < i; i--)
+    {
+        size_t j;
+        unsigned long k;
+
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        j = x % (i + 1);
+        k = keys[i];
+        keys[i] = keys[j];
+        keys[j] = k;
+    }
+
+    __counters_start(fds);
+    t = __now();
+    for (i = 0; i < n; i++)
+        if (!hashmap_get(hm, (void*)keys[i]))
+            abort();
+    t = __now() - t;
+    __counters_stop(fds, counts);
+
+    hashmap_get_stats(hm, &stats);
+    printf("%-24s %10.1f", name, t * 1e9 / n);
+    for (i = 0; i < NCOUNTERS; i++)
+        __print_per_op(counts[i], n);
+    printf(" %10.1f\n", (double)stats.bytes / n);
+
+    hashmap_freeall(hm);
+    free(keys);
+}
+
+int main(int argc, char **argv)
+{
+    size_t n;
+    int t, nthreads;
+
+    if (1 < argc && 0 == strcmp(argv[1], "threads"))
+    {
+        nthreads = 2 < argc ? atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+        printf("90%% get / 10%% put, 1M integer keys, 1 to %d threads\n",
+               nthreads);
+        for (t = 1; t <= nthreads; t *= 2)
+        {
+            bench_threads(1 << 20, t, SHARE_MUTEX);
+            bench_threads(1 << 20, t, SHARE_STRIPED);
+            bench_threads(1 << 20, t, SHARE_LOCKFREE);
+        }
+        return 0;
+    }
+
+    if (1 < argc && 0 == strcmp(argv[1], "hashes"))
+    {
+        bench_hashes();
+        return 0;
+    }
+
+    if (1 < argc && 0 == strcmp(argv[1], "large"))
+    {
+        n = 2 < argc ? strtoul(argv[2], NULL, 10) : 50000000;
+        printf("large integer map, HASHMAP_POW2, n=%zu\n", n);
+        bench_large(n);
+        return 0;
+    }
+
+    if (1 < argc && 0 == strcmp(argv[1], "build"))
+    {
+        n = 2 < argc ? strtoul(argv[2], NULL, 10) : 10000000;
+        nthreads = 3 < argc ? atoi(argv[3]) : sysconf(_SC_NPROCESSORS_ONLN);
+        printf("random integer keys, chained HASHMAP_POW2, n=%zu\n", n);
+        bench_build(n, nthreads);
+        return 0;
+    }
+
+    if (1 < argc && 0 == strcmp(argv[1], "foreach"))
+    {
+        n = 2 < argc ? strtoul(argv[2], NULL, 10) : 10000000;
+        nthreads = 3 < argc ? atoi(argv[3]) : sysconf(_SC_NPROCESSORS_ONLN);
+        printf("summing random integer values, chained, n=%zu\n", n);
+        bench_for_each(n, nthreads, HASHMAP_POW2);
+        printf("summing random integer values, HASHMAP_OPEN_ADDRESSING, "
+               "n=%zu\n", n);
+        bench_for_each(n, nthreads, HASHMAP_OPEN_ADDRESSING);
+        printf("summing random integer values, HASHMAP_ORDERED, n=%zu\n", n);
+        bench_for_each(n, nthreads, HASHMAP_ORDERED);
+        return 0;
+    }
+
+    if (1 < argc && 0 == strcmp(argv[1], "cache"))
+    {
+        size_t sizes[] = { 1 << 14, 1 << 18, 1 << 22 };
+        unsigned int s;
+
+        for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        {
+            n = 2 < argc ? strtoul(argv[2], NULL, 10) : sizes[s];
+            printf("get hit, random integer keys, n=%zu\n", n);
+            printf("%-24s %10s %10s %10s %10s\n", "", "ns/op", "L1D miss",
+                   "LLC miss", "bytes/key");
+            bench_cache(n, "chained", HASHMAP_POW2);
+            bench_cache(n, "open addressing", HASHMAP_OPEN_ADDRESSING);
+            bench_cache(n, "ordered", HASHMAP_ORDERED);
+            bench_cache(n, "inline buckets", HASHMAP_INLINE_BUCKETS);
+            if (2 < argc)
+                break;
+        }
+        return 0;
+    }
+
+    if (1 < argc && 0 == strcmp(argv[1], "stream"))
+    {
+        n = 2 < argc ? strtoul(argv[2], NULL, 10) : 4000000;
+        printf("integer keys and values, n=%zu\n", n);
+        bench_stream(n, 0, 0);
+        printf("integer keys and values, HASHMAP_STREAM_CHECKSUM, n=%zu\n", n);
+        bench_stream(n, 0, HASHMAP_STREAM_CHECKSUM);
+        printf("string keys and values, n=%zu\n", n);
+        bench_stream(n, 1, 0);
+        printf("string keys and values, HASHMAP_STREAM_CHECKSUM, n=%zu\n", n);
+        bench_stream(n, 1, HASHMAP_STREAM_CHECKSUM);
+        return 0;
+    }
+
+    n = 1 < argc ? strtoul(argv[1], NULL, 10) : 16384;
+
+    printf("string keys, FNV-1a, n=%zu\n", n);
+    bench_strings(n, __str_hash);
+    printf("string keys, hashmap_str_hash, n=%zu\n", n);
+    bench_strings(n, __builtin_str_hash);
+
+    printf("sequential integer keys, modulo, n=%zu\n", n);
+    bench_ints(n, 1, 0);
+    printf("sequential integer keys, HASHMAP_POW2, n=%zu\n", n);
+    bench_ints(n, 1, HASHMAP_POW2);
+    printf("integer keys strided by 64, modulo, n=%zu\n", n);
+    bench_ints(n, 64, 0);
+    printf("integer keys strided by 64, HASHMAP_POW2, n=%zu\n", n);
+    bench_ints(n, 64, HASHMAP_POW2);
+
+    printf("random integer keys, chained HASHMAP_POW2, n=%zu\n", n * 64);
+    bench_backend(n * 64, HASHMAP_POW2);
+    printf("random integer keys, HASHMAP_OPEN_ADDRESSING, n=%zu\n", n * 64);
+    bench_backend(n * 64, HASHMAP_OPEN_ADDRESSING);
+    printf("random integer keys, HASHMAP_ORDERED, n=%zu\n", n * 64);
+    bench_backend(n * 64, HASHMAP_ORDERED);
+    printf("random integer keys, hashmap_template.h, n=%zu\n", n * 64);
+    bench_template(n * 64);
+    printf("random integer keys, boxed and by value, n=%zu\n", n * 64);
+    bench_uint(n * 64);
+
+    printf("random integer keys, chained HASHMAP_POW2, n=%zu\n", n * 256);
+    bench_get_many(n * 256, HASHMAP_POW2);
+    printf("random integer keys, HASHMAP_OPEN_ADDRESSING, n=%zu\n", n * 256);
+    bench_get_many(n * 256, HASHMAP_OPEN_ADDRESSING);
+
+    printf("random integer keys, chained HASHMAP_POW2, n=%zu\n", n * 64);
+    bench_reserve(n * 64, HASHMAP_POW2);
+    printf("random integer keys, HASHMAP_OPEN_ADDRESSING, n=%zu\n", n * 64);
+    bench_reserve(n * 64, HASHMAP_OPEN_ADDRESSING);
+
+    printf("random integer keys, chained HASHMAP_POW2, n=%zu\n", n * 64);
+    bench_scan(n * 64, HASHMAP_POW2);
+    printf("random integer keys, HASHMAP_OPEN_ADDRESSING, n=%zu\n", n * 64);
+    bench_scan(n * 64, HASHMAP_OPEN_ADDRESSING);
+    printf("random integer keys, HASHMAP_ORDERED, n=%zu\n", n * 64);
+    bench_scan(n * 64, HASHMAP_ORDERED);
+
+    printf("integer keys, HASHMAP_POW2, n=%zu\n", n * 64);
+    bench_put_latency(n * 64, HASHMAP_POW2);
+    printf("integer keys, HASHMAP_POW2 | HASHMAP_INCREMENTAL, n=%zu\n", n * 64);
+    bench_put_latency(n * 64, HASHMAP_POW2 | HASHMAP_INCREMENTAL);
+    return 0;
+}
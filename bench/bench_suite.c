@@ -0,0 +1,255 @@
+/*
+ * Benchmark suite, for tracking performance over time.
+ *
+ * Runs each workload on each backend at 1K keys and every power of ten
+ * up to the given maximum, and prints one JSON object per measurement:
+ *
+ *   {"workload": "get_hit", "backend": "chained", "keys": 1000,
+ *    "ops": 1000000, "ns_per_op": 10.5, "mops_per_sec": 95.2,
+ *    "peak_rss_kb": 2048, "allocs": 0, "alloc_bytes": 0}
+ *
+ * Every backend and key count runs in a child process of its own, so
+ * that peak RSS is that configuration's alone. allocs and alloc_bytes
+ * count the malloc, calloc, realloc and posix_memalign calls made during
+ * the measurement; the Makefile links with --wrap to count them.
+ *
+ * usage: bench_suite [max_keys]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "linked_list_hashmap.h"
+#include "hashmap_hashes.h"
+
+/* lookups are repeated until there have been at least this many */
+#define MIN_OPS 1000000
+
+typedef struct
+{
+    const char *name;
+    int flags;
+} backend_t;
+
+static const backend_t backends[] = {
+    { "chained", 0 },
+    { "chained_pow2", HASHMAP_POW2 },
+    { "chained_incremental", HASHMAP_POW2 | HASHMAP_INCREMENTAL },
+    { "open_addressing", HASHMAP_OPEN_ADDRESSING },
+    { "ordered", HASHMAP_ORDERED },
+    { "inline_buckets", HASHMAP_INLINE_BUCKETS },
+};
+
+static unsigned long __allocs, __alloc_bytes;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+int __real_posix_memalign(void **ptr, size_t align, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    __allocs++;
+    __alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    __allocs++;
+    __alloc_bytes += nmemb * size;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    __allocs++;
+    __alloc_bytes += size;
+    return __real_realloc(ptr, size);
+}
+
+int __wrap_posix_memalign(void **ptr, size_t align, size_t size)
+{
+    __allocs++;
+    __alloc_bytes += size;
+    return __real_posix_memalign(ptr, align, size);
+}
+
+typedef struct
+{
+    double start;
+    unsigned long allocs;
+    unsigned long alloc_bytes;
+} mark_t;
+
+static double __now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void __mark(mark_t * m)
+{
+    m->allocs = __allocs;
+    m->alloc_bytes = __alloc_bytes;
+    m->start = __now();
+}
+
+static void __emit(
+    const char *workload,
+    const backend_t * b,
+    size_t keys,
+    size_t ops,
+    const mark_t * m
+    )
+{
+    double secs = __now() - m->start;
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    printf("{\"workload\": \"%s\", \"backend\": \"%s\", \"keys\": %zu, "
+           "\"ops\": %zu, \"ns_per_op\": %.2f, \"mops_per_sec\": %.3f, "
+           "\"peak_rss_kb\": %ld, \"allocs\": %lu, \"alloc_bytes\": %lu}\n",
+           workload, b->name, keys, ops, secs * 1e9 / ops,
+           ops / secs / 1e6, ru.ru_maxrss, __allocs - m->allocs,
+           __alloc_bytes - m->alloc_bytes);
+    fflush(stdout);
+}
+
+/**
+ * @return the i'th random looking key. An odd multiplier is a bijection,
+ * so keys never repeat, and none of them is zero. */
+static inline void *__key(size_t i)
+{
+    return (void*)(((i + 1) * 0x9e3779b97f4a7c15UL) | 1UL << 63);
+}
+
+/**
+ * @return how many times to go over n keys to do at least MIN_OPS */
+static size_t __rounds(size_t n)
+{
+    return n < MIN_OPS ? (MIN_OPS + n - 1) / n : 1;
+}
+
+static void __run(const backend_t * b, size_t n)
+{
+    hashmap_t *hm;
+    hashmap_iterator_t iter;
+    hashmap_entry_t *ety;
+    unsigned long x = 88172645463325252UL;
+    size_t i, r, ops;
+    mark_t m;
+
+    hm = hashmap_new_with_flags(hashmap_uintptr_hash, hashmap_uintptr_compare,
+                                11, b->flags);
+    __mark(&m);
+    for (i = 1; i <= n; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    __emit("insert_seq", b, n, n, &m);
+    hashmap_freeall(hm);
+
+    hm = hashmap_new_with_flags(hashmap_uintptr_hash, hashmap_uintptr_compare,
+                                11, b->flags);
+    __mark(&m);
+    for (i = 0; i < n; i++)
+        hashmap_put(hm, __key(i), __key(i));
+    __emit("insert_rand", b, n, n, &m);
+
+    __mark(&m);
+    for (r = 0; r < __rounds(n); r++)
+        for (i = 0; i < n; i++)
+            if (!hashmap_get(hm, __key(i)))
+                abort();
+    __emit("get_hit", b, n, n * __rounds(n), &m);
+
+    __mark(&m);
+    for (r = 0; r < __rounds(n); r++)
+        for (i = n; i < n * 2; i++)
+            if (hashmap_get(hm, __key(i)))
+                abort();
+    __emit("get_miss", b, n, n * __rounds(n), &m);
+
+    /* 80% get, 10% put and 10% remove over twice the keys, so the map
+     * stays about the same size */
+    ops = n * __rounds(n);
+    __mark(&m);
+    for (i = 0; i < ops; i++)
+    {
+        void *key;
+
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        key = __key((x >> 4) % (n * 2));
+
+        switch (x % 10)
+        {
+        case 8:
+            hashmap_put(hm, key, key);
+            break;
+        case 9:
+            hashmap_remove(hm, key);
+            break;
+        default:
+            hashmap_get(hm, key);
+        }
+    }
+    __emit("mixed", b, n, ops, &m);
+
+    ops = 0;
+    __mark(&m);
+    for (r = 0; r < __rounds(n); r++)
+    {
+        hashmap_iterator(hm, &iter);
+        while ((ety = hashmap_iterator_next_entry(hm, &iter)))
+            ops += NULL != ety->val;
+    }
+    __emit("iterate", b, n, ops, &m);
+
+    /* what one doubling costs for each entry moved */
+    ops = hashmap_count(hm);
+    __mark(&m);
+    hashmap_increase_capacity(hm, 2);
+    __emit("resize", b, n, ops, &m);
+
+    __mark(&m);
+    hashmap_clear(hm);
+    __emit("clear", b, n, ops, &m);
+
+    hashmap_freeall(hm);
+}
+
+int main(int argc, char **argv)
+{
+    size_t max = 1 < argc ? strtoul(argv[1], NULL, 10) : 1000000, n;
+    unsigned int b;
+
+    for (n = 1000; n <= max; n *= 10)
+        for (b = 0; b < sizeof(backends) / sizeof(backends[0]); b++)
+        {
+            pid_t pid = fork();
+            int status;
+
+            if (0 == pid)
+            {
+                __run(&backends[b], n);
+                exit(0);
+            }
+
+            waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || 0 != WEXITSTATUS(status))
+            {
+                fprintf(stderr, "%s with %zu keys failed\n",
+                        backends[b].name, n);
+                return 1;
+            }
+        }
+    return 0;
+}
@@ -0,0 +1,445 @@
+/*
+
+   Copyright (c) 2011, Willem-Hendrik Thiart
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+ * The names of its contributors may not be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL WILLEM-HENDRIK THIART BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "linked_list_hashmap.h"
+#include "linked_list_hashmap_private.h"
+#include "concurrent_hashmap.h"
+#include "epoch.h"
+
+typedef struct
+{
+    size_t size;
+    node_t *buckets[];
+} table_t;
+
+/* a lock to a cache line, so that stripes don't contend on lines */
+typedef struct
+{
+    pthread_rwlock_t lock;
+} __attribute__((aligned(64))) stripe_t;
+
+/**
+ * @return an empty table, otherwise NULL if out of memory */
+static table_t *__table_new(size_t size)
+{
+    table_t *t = calloc(1, sizeof(table_t) + size * sizeof(node_t*));
+
+    if (t)
+        t->size = size;
+    return t;
+}
+
+inline static stripe_t *__stripe(concurrent_hashmap_t * h, unsigned long hash)
+{
+    /* buckets are a power of two and at least nstripes, so every bucket
+     * of a stripe has the same low bits whatever the table size */
+    return &((stripe_t*)h->stripes)[hash & (h->nstripes - 1)];
+}
+
+inline static node_t **__bucket(table_t * t, unsigned long hash)
+{
+    return &t->buckets[hash & (t->size - 1)];
+}
+
+/**
+ * Free a table and every node still in it */
+static void __table_free(void *ptr)
+{
+    table_t *t = ptr;
+    size_t ii;
+
+    for (ii = 0; ii < t->size; ii++)
+    {
+        node_t *n = t->buckets[ii], *next;
+
+        for (; n; n = next)
+        {
+            next = n->next;
+            free(n);
+        }
+    }
+    free(t);
+}
+
+static void __lock_all(concurrent_hashmap_t * h, int write)
+{
+    unsigned int i;
+
+    /* always in the same order so that we can't deadlock */
+    for (i = 0; i < h->nstripes; i++)
+        if (write)
+            pthread_rwlock_wrlock(&((stripe_t*)h->stripes)[i].lock);
+        else
+            pthread_rwlock_rdlock(&((stripe_t*)h->stripes)[i].lock);
+}
+
+static void __unlock_all(concurrent_hashmap_t * h)
+{
+    unsigned int i;
+
+    for (i = h->nstripes; 0 < i; i--)
+        pthread_rwlock_unlock(&((stripe_t*)h->stripes)[i - 1].lock);
+}
+
+concurrent_hashmap_t *concurrent_hashmap_new_with_flags(
+    func_longhash_f hash,
+    func_longcmp_f cmp,
+    size_t initial_capacity,
+    unsigned int nstripes,
+    int flags
+    )
+{
+    concurrent_hashmap_t *h = calloc(1, sizeof(concurrent_hashmap_t));
+    unsigned int i;
+
+    if (!h)
+        return NULL;
+    h->flags = flags;
+    h->grow_load = HASHMAP_CHAINED_LOAD;
+    h->hash = hash;
+    h->compare = cmp;
+    h->nstripes = __roundup_pow2(nstripes);
+    if (0 != posix_memalign(&h->stripes, sizeof(stripe_t),
+                            h->nstripes * sizeof(stripe_t)))
+    {
+        free(h);
+        return NULL;
+    }
+    if (initial_capacity < h->nstripes)
+        initial_capacity = h->nstripes;
+    h->table = __table_new(__roundup_pow2(initial_capacity));
+    if (!h->table)
+    {
+        free(h->stripes);
+        free(h);
+        return NULL;
+    }
+
+    for (i = 0; i < h->nstripes; i++)
+        pthread_rwlock_init(&((stripe_t*)h->stripes)[i].lock, NULL);
+    return h;
+}
+
+concurrent_hashmap_t *concurrent_hashmap_new(
+    func_longhash_f hash,
+    func_longcmp_f cmp,
+    size_t initial_capacity,
+    unsigned int nstripes
+    )
+{
+    return concurrent_hashmap_new_with_flags(hash, cmp, initial_capacity,
+                                             nstripes, 0);
+}
+
+void concurrent_hashmap_set_grow_load(
+    concurrent_hashmap_t * h,
+    double grow_load
+    )
+{
+    assert(0 < grow_load);
+    h->grow_load = grow_load;
+}
+
+void concurrent_hashmap_freeall(concurrent_hashmap_t * h)
+{
+    unsigned int i;
+
+    __table_free(h->table);
+
+    /* our retired nodes can go now if no other map's readers are about */
+    if (h->flags & CONCURRENT_HASHMAP_LOCKFREE_READS)
+        hashmap_epoch_flush();
+
+    for (i = 0; i < h->nstripes; i++)
+        pthread_rwlock_destroy(&((stripe_t*)h->stripes)[i].lock);
+    free(h->stripes);
+    free(h);
+}
+
+size_t concurrent_hashmap_count(concurrent_hashmap_t * h)
+{
+    return __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+}
+
+/**
+ * @return the node holding this key, otherwise NULL */
+static node_t *__find(
+    concurrent_hashmap_t * h,
+    node_t * n,
+    unsigned long hash,
+    const void *key
+    )
+{
+    /* lock-free readers may be walking alongside a writer */
+    for (; n; n = __atomic_load_n(&n->next, __ATOMIC_ACQUIRE))
+        /* only call compare when the hashes agree */
+        if (n->hash == hash && 0 == h->compare(key, n->ety.key))
+            return n;
+    return NULL;
+}
+
+static void *__get_lockfree(
+    concurrent_hashmap_t * h,
+    unsigned long hash,
+    const void *key
+    )
+{
+    table_t *t;
+    node_t *n;
+    void *val;
+
+    hashmap_epoch_enter();
+    t = __atomic_load_n(&h->table, __ATOMIC_ACQUIRE);
+    n = __find(h, __atomic_load_n(__bucket(t, hash), __ATOMIC_ACQUIRE),
+               hash, key);
+    val = n ? __atomic_load_n(&n->ety.val, __ATOMIC_ACQUIRE) : NULL;
+    hashmap_epoch_leave();
+
+    return val;
+}
+
+void *concurrent_hashmap_get(
+    concurrent_hashmap_t * h,
+    const void *key
+    )
+{
+    unsigned long hash;
+    stripe_t *s;
+    node_t *n;
+    void *val;
+
+    if (!key)
+        return NULL;
+
+    hash = __mix_hash(h->hash(key));
+
+    if (h->flags & CONCURRENT_HASHMAP_LOCKFREE_READS)
+        return __get_lockfree(h, hash, key);
+
+    s = __stripe(h, hash);
+
+    /* holding any stripe keeps resizes away, so the table can't change */
+    pthread_rwlock_rdlock(&s->lock);
+    n = __find(h, *__bucket(h->table, hash), hash, key);
+    val = n ? n->ety.val : NULL;
+    pthread_rwlock_unlock(&s->lock);
+
+    return val;
+}
+
+int concurrent_hashmap_contains_key(
+    concurrent_hashmap_t * h,
+    const void *key
+    )
+{
+    return NULL != concurrent_hashmap_get(h, key);
+}
+
+/**
+ * Double the table, unless someone else already has.
+ * @param size : the table size that looked too small */
+static void __grow(concurrent_hashmap_t * h, size_t size)
+{
+    table_t *t, *t_new;
+    size_t ii;
+
+    __lock_all(h, 1);
+
+    t = h->table;
+    if (t->size != size)
+        goto done;
+
+    /* out of memory; the map still works, its chains just get longer */
+    if (!(t_new = __table_new(t->size * 2)))
+        goto done;
+
+    for (ii = 0; ii < t->size; ii++)
+    {
+        node_t *n = t->buckets[ii], *next;
+
+        for (; n; n = next)
+        {
+            node_t **b = __bucket(t_new, n->hash);
+
+            next = n->next;
+
+            /* readers may still be walking the old chains, so they keep
+             * their nodes and the new table gets copies */
+            if (h->flags & CONCURRENT_HASHMAP_LOCKFREE_READS)
+            {
+                node_t *copy = malloc(sizeof(node_t));
+
+                /* t_new only holds copies, so dropping it loses nothing */
+                if (!copy)
+                {
+                    __table_free(t_new);
+                    goto done;
+                }
+                *copy = *n;
+                n = copy;
+            }
+
+            n->next = *b;
+            *b = n;
+        }
+    }
+    __atomic_store_n(&h->table, t_new, __ATOMIC_RELEASE);
+    __unlock_all(h);
+
+    if (h->flags & CONCURRENT_HASHMAP_LOCKFREE_READS)
+        hashmap_epoch_retire(t, __table_free);
+    else
+        free(t);
+    return;
+
+done:
+    __unlock_all(h);
+}
+
+void *concurrent_hashmap_put(
+    concurrent_hashmap_t * h,
+    void *key,
+    void *val
+    )
+{
+    unsigned long hash;
+    stripe_t *s;
+    node_t **b, *n;
+    size_t count, size;
+
+    if (!key || !val)
+        return NULL;
+
+    hash = __mix_hash(h->hash(key));
+    s = __stripe(h, hash);
+
+    pthread_rwlock_wrlock(&s->lock);
+    size = ((table_t*)h->table)->size;
+    b = __bucket(h->table, hash);
+
+    /* if same key, then we are just replacing val */
+    if ((n = __find(h, *b, hash, key)))
+    {
+        void *val_prev = n->ety.val;
+        __atomic_store_n(&n->ety.val, val, __ATOMIC_RELEASE);
+        pthread_rwlock_unlock(&s->lock);
+        return val_prev;
+    }
+
+    if (!(n = malloc(sizeof(node_t))))
+    {
+        pthread_rwlock_unlock(&s->lock);
+        return NULL;
+    }
+    n->ety.key = key;
+    n->ety.val = val;
+    n->hash = hash;
+    n->next = *b;
+    /* publish only once the node is fully written */
+    __atomic_store_n(b, n, __ATOMIC_RELEASE);
+    count = __atomic_add_fetch(&h->count, 1, __ATOMIC_RELAXED);
+    pthread_rwlock_unlock(&s->lock);
+
+    /* we have to let go of our stripe before we can take all of them */
+    if (size * h->grow_load <= count)
+        __grow(h, size);
+
+    return NULL;
+}
+
+void *concurrent_hashmap_remove(
+    concurrent_hashmap_t * h,
+    const void *key
+    )
+{
+    unsigned long hash;
+    stripe_t *s;
+    node_t **b, *n;
+    node_t *removed = NULL;
+    void *val = NULL;
+
+    if (!key)
+        return NULL;
+
+    hash = __mix_hash(h->hash(key));
+    s = __stripe(h, hash);
+
+    pthread_rwlock_wrlock(&s->lock);
+    for (b = __bucket(h->table, hash); (n = *b); b = &n->next)
+    {
+        if (n->hash != hash || 0 != h->compare(key, n->ety.key))
+            continue;
+
+        /* n->next stays intact for any reader standing on n */
+        __atomic_store_n(b, n->next, __ATOMIC_RELEASE);
+        val = n->ety.val;
+        removed = n;
+        __atomic_sub_fetch(&h->count, 1, __ATOMIC_RELAXED);
+        break;
+    }
+    pthread_rwlock_unlock(&s->lock);
+
+    if (removed)
+    {
+        if (h->flags & CONCURRENT_HASHMAP_LOCKFREE_READS)
+            hashmap_epoch_retire(removed, free);
+        else
+            free(removed);
+    }
+
+    return val;
+}
+
+void concurrent_hashmap_for_each(
+    concurrent_hashmap_t * h,
+    func_entry_f fn,
+    void *udata
+    )
+{
+    table_t *t;
+    size_t ii;
+
+    __lock_all(h, 0);
+    t = h->table;
+    for (ii = 0; ii < t->size; ii++)
+    {
+        node_t *n;
+
+        for (n = t->buckets[ii]; n; n = n->next)
+            fn(udata, &n->ety);
+    }
+    __unlock_all(h);
+}
+
+/*--------------------------------------------------------------79-characters-*/
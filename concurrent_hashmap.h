@@ -0,0 +1,124 @@
+#ifndef CONCURRENT_HASHMAP_H
+#define CONCURRENT_HASHMAP_H
+
+#include "linked_list_hashmap.h"
+
+/**
+ * A hashmap that is safe to share between threads.
+ *
+ * Buckets are split into stripes, each with its own read/write lock. Gets
+ * take their key's stripe shared, puts and removes take it exclusively,
+ * and a resize takes every stripe exclusively. A key's stripe depends
+ * only on its hash, so it stays the same across resizes. */
+typedef struct
+{
+    size_t count;
+    void *table;
+    func_longhash_f hash;
+    func_longcmp_f compare;
+    void *stripes;
+    unsigned int nstripes;
+    int flags;
+    /* see concurrent_hashmap_set_grow_load() */
+    double grow_load;
+} concurrent_hashmap_t;
+
+enum {
+    /* gets take no locks at all. Writers still lock their stripe, publish
+     * with atomic stores, and hand removed nodes and old tables to epoch
+     * based reclamation instead of freeing them. A get may return a value
+     * that was replaced while it ran. Resizes copy every node. */
+    CONCURRENT_HASHMAP_LOCKFREE_READS = 1 << 0,
+};
+
+typedef void (*func_entry_f) (void *udata, hashmap_entry_t * entry);
+
+/**
+ * @param nstripes : number of locks, rounded up to a power of two.
+ *                   A few times the number of threads is a good start. */
+concurrent_hashmap_t *concurrent_hashmap_new(
+    func_longhash_f hash,
+    func_longcmp_f cmp,
+    size_t initial_capacity,
+    unsigned int nstripes
+);
+
+/**
+ * @param flags : CONCURRENT_HASHMAP_* flags */
+concurrent_hashmap_t *concurrent_hashmap_new_with_flags(
+    func_longhash_f hash,
+    func_longcmp_f cmp,
+    size_t initial_capacity,
+    unsigned int nstripes,
+    int flags
+);
+
+/**
+ * Set when the table doubles, like hashmap_set_resize_policy's grow_load.
+ * Only call this before the map is shared with other threads.
+ * @param grow_load : double before a put once count / size reaches this.
+ *                    0.5 by default, the same as a chained hashmap_t */
+void concurrent_hashmap_set_grow_load(
+    concurrent_hashmap_t * hmap,
+    double grow_load
+);
+
+/**
+ * Free all the memory related to this hash.
+ * This includes the actual h itself.
+ * No other thread may be using the hash. */
+void concurrent_hashmap_freeall(
+    concurrent_hashmap_t * hmap
+);
+
+/**
+ * @return number of items within hash */
+size_t concurrent_hashmap_count(
+    concurrent_hashmap_t * hmap
+);
+
+/**
+ * Get this key's value.
+ * @return key's item, otherwise NULL */
+void *concurrent_hashmap_get(
+    concurrent_hashmap_t * hmap,
+    const void *key
+);
+
+/**
+ * Is this key inside this map?
+ * @return 1 if key is in hash, otherwise 0 */
+int concurrent_hashmap_contains_key(
+    concurrent_hashmap_t * hmap,
+    const void *key
+);
+
+/**
+ * Associate key with val.
+ * @return previous associated val; otherwise NULL, which is also what
+ *         happens if there's no memory for the entry */
+void *concurrent_hashmap_put(
+    concurrent_hashmap_t * hmap,
+    void *key,
+    void *val
+);
+
+/**
+ * Remove this key and value from the map.
+ * @return value of key, or NULL on failure */
+void *concurrent_hashmap_remove(
+    concurrent_hashmap_t * hmap,
+    const void *key
+);
+
+/**
+ * Call fn on every entry.
+ * Writers are held off until fn has seen every entry, so fn must not
+ * write to this map. */
+void concurrent_hashmap_for_each(
+    concurrent_hashmap_t * hmap,
+    func_entry_f fn,
+    void *udata
+);
+
+#endif /* CONCURRENT_HASHMAP_H */
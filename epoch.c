@@ -0,0 +1,219 @@
+/*
+
+   Copyright (c) 2011, Willem-Hendrik Thiart
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+ * The names of its contributors may not be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL WILLEM-HENDRIK THIART BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "epoch.h"
+
+/* We keep three lists of retired memory, one for each of the last three
+ * epochs. Memory retired in epoch e is freed when we move on to e + 3; by
+ * then every reader has been seen in e + 1 or later, which is after the
+ * memory got unlinked. */
+#define NLIMBO 3
+
+typedef struct record_s record_t;
+
+/* one for each thread that has ever read */
+struct record_s
+{
+    /* epoch this thread's reader is in, or 0 when it isn't reading */
+    unsigned long epoch;
+    unsigned int depth;
+    int in_use;
+    record_t *next;
+} __attribute__((aligned(64)));
+
+typedef struct retired_s retired_t;
+
+struct retired_s
+{
+    void *ptr;
+    func_retire_f fn;
+    retired_t *next;
+};
+
+static unsigned long __epoch = 1;
+static record_t *__records;
+static retired_t *__limbo[NLIMBO];
+static pthread_mutex_t __lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t __key;
+static pthread_once_t __key_once = PTHREAD_ONCE_INIT;
+static __thread record_t *__rec;
+
+/**
+ * Let another thread have this thread's record once it exits. */
+static void __record_release(void *ptr)
+{
+    record_t *r = ptr;
+
+    __atomic_store_n(&r->epoch, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&r->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void __key_create(void)
+{
+    pthread_key_create(&__key, __record_release);
+}
+
+static record_t *__record(void)
+{
+    record_t *r;
+
+    if (__rec)
+        return __rec;
+
+    pthread_once(&__key_once, __key_create);
+
+    /* reuse a record left behind by a thread that has exited */
+    for (r = __atomic_load_n(&__records, __ATOMIC_ACQUIRE); r; r = r->next)
+    {
+        int free_ = 0;
+
+        if (__atomic_compare_exchange_n(&r->in_use, &free_, 1, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            break;
+    }
+
+    if (!r)
+    {
+        if (0 != posix_memalign((void**)&r, sizeof(record_t), sizeof(record_t)))
+            abort();
+        r->epoch = 0;
+        r->depth = 0;
+        r->in_use = 1;
+        pthread_mutex_lock(&__lock);
+        r->next = __records;
+        __atomic_store_n(&__records, r, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&__lock);
+    }
+
+    pthread_setspecific(__key, r);
+    __rec = r;
+    return r;
+}
+
+void hashmap_epoch_enter(void)
+{
+    record_t *r = __record();
+
+    if (0 < r->depth++)
+        return;
+
+    /* must be visible before we read anything shared */
+    __atomic_store_n(&r->epoch, __atomic_load_n(&__epoch, __ATOMIC_SEQ_CST),
+                     __ATOMIC_SEQ_CST);
+}
+
+void hashmap_epoch_leave(void)
+{
+    record_t *r = __rec;
+
+    assert(r && 0 < r->depth);
+    if (0 < --r->depth)
+        return;
+
+    __atomic_store_n(&r->epoch, 0, __ATOMIC_RELEASE);
+}
+
+static void __free_list(retired_t * l)
+{
+    while (l)
+    {
+        retired_t *next = l->next;
+
+        l->fn(l->ptr);
+        free(l);
+        l = next;
+    }
+}
+
+/**
+ * Move to the next epoch, if every reader has caught up with this one.
+ * Must hold __lock.
+ * @return memory that is now safe to free, or NULL */
+static retired_t *__try_advance(void)
+{
+    unsigned long e = __atomic_load_n(&__epoch, __ATOMIC_SEQ_CST);
+    retired_t *freeable;
+    record_t *r;
+
+    for (r = __atomic_load_n(&__records, __ATOMIC_ACQUIRE); r; r = r->next)
+    {
+        unsigned long re = __atomic_load_n(&r->epoch, __ATOMIC_SEQ_CST);
+
+        if (0 != re && e != re)
+            return NULL;
+    }
+
+    __atomic_store_n(&__epoch, e + 1, __ATOMIC_SEQ_CST);
+    freeable = __limbo[(e + 1) % NLIMBO];
+    __limbo[(e + 1) % NLIMBO] = NULL;
+    return freeable;
+}
+
+void hashmap_epoch_retire(void *ptr, func_retire_f fn)
+{
+    retired_t *l = malloc(sizeof(retired_t)), *freeable;
+    unsigned long e;
+
+    assert(!__rec || 0 == __rec->depth);
+
+    l->ptr = ptr;
+    l->fn = fn;
+
+    pthread_mutex_lock(&__lock);
+    e = __atomic_load_n(&__epoch, __ATOMIC_SEQ_CST);
+    l->next = __limbo[e % NLIMBO];
+    __limbo[e % NLIMBO] = l;
+    freeable = __try_advance();
+    pthread_mutex_unlock(&__lock);
+
+    /* don't hold the lock while running destructors */
+    __free_list(freeable);
+}
+
+void hashmap_epoch_flush(void)
+{
+    int i;
+
+    for (i = 0; i < NLIMBO; i++)
+    {
+        retired_t *freeable;
+
+        pthread_mutex_lock(&__lock);
+        freeable = __try_advance();
+        pthread_mutex_unlock(&__lock);
+
+        __free_list(freeable);
+    }
+}
+
+/*--------------------------------------------------------------79-characters-*/
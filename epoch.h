@@ -0,0 +1,32 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+/*
+ * Epoch based reclamation, so that lock-free readers never touch freed
+ * memory.
+ *
+ * Readers bracket their reads with hashmap_epoch_enter/leave. Writers
+ * unlink memory so that no new reader can reach it, then retire it. It
+ * gets freed once every reader that was around at the time has left.
+ * There is one set of epochs shared by every map in the process.
+ */
+
+typedef void (*func_retire_f) (void *ptr);
+
+/**
+ * Start a read-side critical section. These may nest. */
+void hashmap_epoch_enter(void);
+
+void hashmap_epoch_leave(void);
+
+/**
+ * Have fn(ptr) called once no reader can still be looking at ptr.
+ * Must not be called from inside a read-side critical section. */
+void hashmap_epoch_retire(void *ptr, func_retire_f fn);
+
+/**
+ * Free whatever retired memory can be freed right now, without waiting
+ * for readers. */
+void hashmap_epoch_flush(void);
+
+#endif /* EPOCH_H */
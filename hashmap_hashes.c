@@ -0,0 +1,241 @@
+/*
+
+   Copyright (c) 2011, Willem-Hendrik Thiart
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+ * The names of its contributors may not be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL WILLEM-HENDRIK THIART BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+/*
+ * Built-in hash functions.
+ *
+ * The byte hash follows wyhash final version 4: 64x64->128 bit multiplies
+ * folded back down to 64 bits, taking 16 bytes a step and 48 bytes a step
+ * on long keys. On the key sizes maps see this beats SIMD hashes, whose
+ * setup costs more than the keys take to hash. Reads are unaligned
+ * memcpy()s, which compilers turn into plain loads.
+ */
+
+#include <string.h>
+#include <stdint.h>
+
+#include "hashmap_hashes.h"
+
+static const uint64_t __secret[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+    0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+/**
+ * Replace a and b with the low and high halves of a * b. */
+inline static void __mum(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t)*a * *b;
+
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    /* no 128 bit type, as on most 32 bit targets, so multiply the 32 bit
+     * halves and add up the carries */
+    uint64_t ha = *a >> 32, hb = *b >> 32;
+    uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl, lo;
+
+    lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+/**
+ * @return the two halves of a * b folded together */
+inline static uint64_t __mix(uint64_t a, uint64_t b)
+{
+    __mum(&a, &b);
+    return a ^ b;
+}
+
+inline static uint64_t __r8(const uint8_t *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, 8);
+    return v;
+}
+
+inline static uint64_t __r4(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, 4);
+    return v;
+}
+
+/**
+ * @return 1 to 3 bytes, read without going past the end */
+inline static uint64_t __r3(const uint8_t *p, size_t k)
+{
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1];
+}
+
+unsigned long hashmap_hash_bytes(
+    const void *data,
+    size_t len,
+    unsigned long seed_
+    )
+{
+    const uint8_t *p = data;
+    uint64_t seed = seed_, a, b;
+
+    seed ^= __mix(seed ^ __secret[0], __secret[1]);
+
+    if (__builtin_expect(len <= 16, 1))
+    {
+        if (4 <= len)
+        {
+            /* two overlapping pairs of 4 byte reads cover 4 to 16 bytes */
+            a = (__r4(p) << 32) | __r4(p + ((len >> 3) << 2));
+            b = (__r4(p + len - 4) << 32) | __r4(p + len - 4 - ((len >> 3) << 2));
+        }
+        else if (0 < len)
+        {
+            a = __r3(p, len);
+            b = 0;
+        }
+        else
+            a = b = 0;
+    }
+    else
+    {
+        size_t i = len;
+
+        if (48 < i)
+        {
+            /* three independent lanes, so the multiplies overlap */
+            uint64_t see1 = seed, see2 = seed;
+
+            do
+            {
+                seed = __mix(__r8(p) ^ __secret[1], __r8(p + 8) ^ seed);
+                see1 = __mix(__r8(p + 16) ^ __secret[2], __r8(p + 24) ^ see1);
+                see2 = __mix(__r8(p + 32) ^ __secret[3], __r8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            }
+            while (48 < i);
+            seed ^= see1 ^ see2;
+        }
+
+        for (; 16 < i; i -= 16, p += 16)
+            seed = __mix(__r8(p) ^ __secret[1], __r8(p + 8) ^ seed);
+
+        /* the last 16 bytes, which may overlap what we've already done */
+        a = __r8(p + i - 16);
+        b = __r8(p + i - 8);
+    }
+
+    a ^= __secret[1];
+    b ^= seed;
+    __mum(&a, &b);
+    return __mix(a ^ __secret[0] ^ len, b ^ __secret[1]);
+}
+
+/**
+ * @return well mixed hash of a 64 bit integer */
+inline static unsigned long __hash_u64(uint64_t x)
+{
+    /* one multiply leaves the top input bits barely touching the low
+     * output bits, so fold twice, like wyhash64 */
+    uint64_t a = x ^ __secret[0], b = x ^ __secret[1];
+
+    __mum(&a, &b);
+    return __mix(a ^ __secret[0], b ^ __secret[1]);
+}
+
+unsigned long hashmap_str_hash(const void *key)
+{
+    return hashmap_hash_bytes(key, strlen(key), 0);
+}
+
+long hashmap_str_compare(const void *key1, const void *key2)
+{
+    return strcmp(key1, key2);
+}
+
+unsigned long hashmap_bytes_hash(const void *key)
+{
+    const hashmap_bytes_t *k = key;
+
+    return hashmap_hash_bytes(k->data, k->len, 0);
+}
+
+long hashmap_bytes_compare(const void *key1, const void *key2)
+{
+    const hashmap_bytes_t *k1 = key1, *k2 = key2;
+
+    if (k1->len != k2->len)
+        return k1->len < k2->len ? -1 : 1;
+    return memcmp(k1->data, k2->data, k1->len);
+}
+
+unsigned long hashmap_u32_hash(const void *key)
+{
+    return __hash_u64(*(const uint32_t*)key);
+}
+
+long hashmap_u32_compare(const void *key1, const void *key2)
+{
+    const uint32_t a = *(const uint32_t*)key1, b = *(const uint32_t*)key2;
+
+    return (a > b) - (a < b);
+}
+
+unsigned long hashmap_u64_hash(const void *key)
+{
+    return __hash_u64(*(const uint64_t*)key);
+}
+
+long hashmap_u64_compare(const void *key1, const void *key2)
+{
+    const uint64_t a = *(const uint64_t*)key1, b = *(const uint64_t*)key2;
+
+    return (a > b) - (a < b);
+}
+
+unsigned long hashmap_uintptr_hash(const void *key)
+{
+    return __hash_u64((uintptr_t)key);
+}
+
+long hashmap_uintptr_compare(const void *key1, const void *key2)
+{
+    const uintptr_t a = (uintptr_t)key1, b = (uintptr_t)key2;
+
+    return (a > b) - (a < b);
+}
+
+/*--------------------------------------------------------------79-characters-*/
@@ -0,0 +1,61 @@
+#ifndef HASHMAP_HASHES_H
+#define HASHMAP_HASHES_H
+
+#include <stddef.h>
+
+/*
+ * Ready-made hash and compare functions for common kinds of key.
+ * The hashes are wyhash (public domain) at heart, so every bit of the key
+ * reaches every bit of the hash and weak keys don't turn into long chains.
+ */
+
+/**
+ * A key that is a run of bytes that isn't NUL-terminated. Keys of the map
+ * are pointers to these. */
+typedef struct
+{
+    const void *data;
+    size_t len;
+} hashmap_bytes_t;
+
+/**
+ * Hash any run of bytes.
+ * @param seed : picks one of 2^64 hash functions */
+unsigned long hashmap_hash_bytes(
+    const void *data,
+    size_t len,
+    unsigned long seed
+);
+
+/**
+ * Keys are NUL-terminated strings. */
+unsigned long hashmap_str_hash(const void *key);
+
+long hashmap_str_compare(const void *key1, const void *key2);
+
+/**
+ * Keys point to hashmap_bytes_t. */
+unsigned long hashmap_bytes_hash(const void *key);
+
+long hashmap_bytes_compare(const void *key1, const void *key2);
+
+/**
+ * Keys point to uint32_t. */
+unsigned long hashmap_u32_hash(const void *key);
+
+long hashmap_u32_compare(const void *key1, const void *key2);
+
+/**
+ * Keys point to uint64_t. */
+unsigned long hashmap_u64_hash(const void *key);
+
+long hashmap_u64_compare(const void *key1, const void *key2);
+
+/**
+ * Keys are integers cast to pointers, eg. (void*)1234. Zero can't be a
+ * key, since NULL keys are never stored. */
+unsigned long hashmap_uintptr_hash(const void *key);
+
+long hashmap_uintptr_compare(const void *key1, const void *key2);
+
+#endif /* HASHMAP_HASHES_H */
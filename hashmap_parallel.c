@@ -0,0 +1,520 @@
+/*
+
+   Copyright (c) 2011, Willem-Hendrik Thiart
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+ * The names of its contributors may not be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL WILLEM-HENDRIK THIART BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "linked_list_hashmap.h"
+#include "linked_list_hashmap_private.h"
+#include "hashmap_parallel.h"
+
+/* fewer entries than this aren't worth starting threads for */
+#define MIN_PARALLEL 4096
+
+/* bucket ranges for each thread, so that a thread that draws a slow
+ * range doesn't hold everyone up */
+#define RANGES_PER_THREAD 4
+
+/* more ranges than this and copying entries out to them thrashes */
+#define MAX_RANGES 1024
+
+/* small enough a range's buckets fit in cache while it is filled */
+#define RANGE_BYTES (256 * 1024)
+
+/* chain nodes in each slab a thread carves its nodes out of */
+#define SLAB_SIZE 4096
+
+/* positions for each thread to walk, so that a thread stuck on long
+ * chains or a dense stretch doesn't hold everyone up */
+#define CHUNKS_PER_THREAD 16
+
+/* fewest positions a thread takes at a time */
+#define MIN_CHUNK 4096
+
+typedef struct
+{
+    void *key;
+    void *val;
+    unsigned long hash;
+} item_t;
+
+typedef struct
+{
+    hashmap_t *h;
+    const hashmap_entry_t *entries;
+    size_t n;
+    int nthreads;
+    size_t nranges;
+    /* bucket index >> this is the bucket's range */
+    unsigned int range_shift;
+    unsigned long *hashes;
+    /* for each thread, how many of its entries fall in each range; turned
+     * into where the thread puts them in items */
+    size_t *counts;
+    /* the entries sorted by range, keeping their order within a range */
+    item_t *items;
+    /* where each range starts in items, plus the end */
+    size_t *range_start;
+    /* next range a thread can take */
+    size_t next_range;
+} build_t;
+
+typedef struct
+{
+    build_t *b;
+    int idx;
+    /* chain nodes this thread has taken, newest slab first */
+    slab_t *slabs;
+    slab_t *slabs_tail;
+    size_t slab_left;
+    size_t nodes;
+    size_t count;
+    /* the range and item being filled when a slab couldn't be had, for
+     * the calling thread to carry on from */
+    int stopped;
+    size_t range;
+    size_t item;
+} worker_t;
+
+typedef struct
+{
+    hashmap_t *h;
+    hashmap_for_each_f fn;
+    size_t end;
+    size_t chunk;
+    /* where the next chunk a thread takes starts */
+    size_t next;
+} walk_t;
+
+typedef struct
+{
+    walk_t *wk;
+    void *ctx;
+} walker_t;
+
+typedef struct
+{
+    pthread_t id;
+    int started;
+} thread_t;
+
+inline static size_t __range(build_t * b, unsigned long hash)
+{
+    return (hash & (b->h->arraySize - 1)) >> b->range_shift;
+}
+
+inline static size_t __slice_start(build_t * b, int idx)
+{
+    return b->n * idx / b->nthreads;
+}
+
+inline static int __skip(const hashmap_entry_t * ety)
+{
+    return !ety->key || !ety->val;
+}
+
+/**
+ * Hash this thread's slice of the entries, and count them by range. */
+static void *__count(void *arg)
+{
+    worker_t *w = arg;
+    build_t *b = w->b;
+    size_t *counts = &b->counts[w->idx * b->nranges];
+    size_t i, end = __slice_start(b, w->idx + 1);
+
+    for (i = __slice_start(b, w->idx); i < end; i++)
+    {
+        if (__skip(&b->entries[i]))
+            continue;
+        b->hashes[i] = __mix_hash(b->h->hash(b->entries[i].key));
+        counts[__range(b, b->hashes[i])]++;
+    }
+    return NULL;
+}
+
+/**
+ * Copy this thread's slice of the entries to where their ranges start. */
+static void *__scatter(void *arg)
+{
+    worker_t *w = arg;
+    build_t *b = w->b;
+    size_t *offsets = &b->counts[w->idx * b->nranges];
+    size_t i, end = __slice_start(b, w->idx + 1);
+
+    for (i = __slice_start(b, w->idx); i < end; i++)
+    {
+        item_t *it;
+
+        if (__skip(&b->entries[i]))
+            continue;
+        it = &b->items[offsets[__range(b, b->hashes[i])]++];
+        it->key = b->entries[i].key;
+        it->val = b->entries[i].val;
+        it->hash = b->hashes[i];
+    }
+    return NULL;
+}
+
+/**
+ * @return a chain node, otherwise NULL if there's no memory for a slab */
+static node_t *__node_alloc(worker_t * w)
+{
+    node_t *n;
+
+    if (0 == w->slab_left)
+    {
+        slab_t *s = malloc(sizeof(slab_t) + SLAB_SIZE * sizeof(node_t));
+
+        if (!s)
+            return NULL;
+        s->size = SLAB_SIZE;
+        s->next = w->slabs;
+        w->slabs = s;
+        if (!w->slabs_tail)
+            w->slabs_tail = s;
+        w->slab_left = SLAB_SIZE;
+    }
+
+    n = &w->slabs->nodes[SLAB_SIZE - w->slab_left--];
+    w->nodes++;
+    return n;
+}
+
+/**
+ * Put an item into a bucket that only this thread touches.
+ * @return 0 on success, otherwise -1 with the bucket left as it was */
+static int __fill_one(worker_t * w, const item_t * it)
+{
+    hashmap_t *h = w->b->h;
+    node_t *node = &((node_t*)h->array)[it->hash & (h->arraySize - 1)];
+
+    if (node->ety.key)
+    {
+        /* a later entry for the same key replaces the value */
+        do
+        {
+            if (node->hash == it->hash && 0 == h->compare(it->key,
+                                                          node->ety.key))
+            {
+                node->ety.val = it->val;
+                return 0;
+            }
+        }
+        while (node->next && (node = node->next));
+
+        if (!(node->next = __node_alloc(w)))
+            return -1;
+        node = node->next;
+    }
+
+    node->ety.key = it->key;
+    node->ety.val = it->val;
+    node->hash = it->hash;
+    node->next = NULL;
+    w->count++;
+    return 0;
+}
+
+/**
+ * Take the next range to fill.
+ * @return 0 once there are none left */
+static int __take_range(worker_t * w)
+{
+    build_t *b = w->b;
+
+    w->range = __atomic_fetch_add(&b->next_range, 1, __ATOMIC_RELAXED);
+    if (b->nranges <= w->range)
+        return 0;
+    w->item = b->range_start[w->range];
+    return 1;
+}
+
+/**
+ * Fill in bucket ranges until there are none left. A worker that runs out
+ * of memory stops where it is, and carries on from there next time.
+ * @return NULL once done, otherwise the worker */
+static void *__fill(void *arg)
+{
+    worker_t *w = arg;
+    build_t *b = w->b;
+
+    if (!w->stopped && !__take_range(w))
+        return NULL;
+    w->stopped = 0;
+    do
+        for (; w->item < b->range_start[w->range + 1]; w->item++)
+            if (__fill_one(w, &b->items[w->item]))
+            {
+                w->stopped = 1;
+                return w;
+            }
+    while (__take_range(w));
+    return NULL;
+}
+
+/**
+ * Walk chunks of positions until there are none left. */
+static void *__walk(void *arg)
+{
+    walker_t *w = arg;
+    walk_t *wk = w->wk;
+    size_t begin;
+
+    while ((begin = __atomic_fetch_add(&wk->next, wk->chunk,
+                                       __ATOMIC_RELAXED)) < wk->end)
+        wk->h->backend->for_each_range(wk->h, begin,
+                                       wk->end - begin < wk->chunk ?
+                                       wk->end : begin + wk->chunk,
+                                       wk->fn, w->ctx);
+    return NULL;
+}
+
+/**
+ * Run fn on every worker, one of them on this thread. A worker whose
+ * thread can't be started is run on this thread too, once its own is done,
+ * and so is one that fn hands back because it couldn't finish.
+ * @param size : size of a worker
+ * @param fn : returns NULL once the worker is done
+ * @return 0 on success, otherwise -1 if a worker couldn't finish even on
+ *         this thread */
+static int __run(
+    void *workers,
+    size_t size,
+    int nthreads,
+    void *(*fn)(void *)
+    )
+{
+    /* without memory to keep track of threads, every worker runs here */
+    thread_t *threads = calloc(nthreads, sizeof(thread_t));
+    int t, err = 0;
+
+    for (t = 1; threads && t < nthreads; t++)
+        threads[t].started = 0 == pthread_create(&threads[t].id, NULL, fn,
+                                                 (char*)workers + t * size);
+    for (t = 0; t < nthreads; t++)
+    {
+        void *w = (char*)workers + t * size, *left;
+
+        if (threads && threads[t].started)
+            pthread_join(threads[t].id, &left);
+        else
+            left = fn(w);
+        if (left && fn(w))
+            err = -1;
+    }
+    free(threads);
+    return err;
+}
+
+/**
+ * Hand the chain nodes the workers took over to the map's reservoir. */
+static void __merge_nodes(hashmap_t * h, worker_t * workers, int nthreads)
+{
+    slab_t *tail = NULL;
+    int t;
+
+    assert(!h->pool_slabs);
+    for (t = 0; t < nthreads; t++)
+    {
+        worker_t *w = &workers[t];
+        slab_t *s;
+
+        h->count += w->count;
+        if (!w->slabs)
+            continue;
+
+        /* what's left of the slab being carved goes on the free list */
+        for (; 0 < w->slab_left; w->slab_left--)
+        {
+            node_t *n = &w->slabs->nodes[SLAB_SIZE - w->slab_left];
+
+            n->next = h->pool_free;
+            h->pool_free = n;
+        }
+
+        for (s = w->slabs; s; s = s->next)
+            h->pool_capacity += s->size;
+        h->pool_in_use += w->nodes;
+
+        if (!tail)
+            tail = w->slabs_tail;
+        w->slabs_tail->next = h->pool_slabs;
+        h->pool_slabs = w->slabs;
+    }
+
+    /* every slab has been carved all the way */
+    h->pool_slab_cur = tail;
+    h->pool_slab_left = 0;
+}
+
+hashmap_t *hashmap_build_parallel(
+    func_longhash_f hash,
+    func_longcmp_f cmp,
+    const hashmap_entry_t * entries,
+    size_t n,
+    int nthreads,
+    int flags
+    )
+{
+    hashmap_t *h;
+    build_t b;
+    worker_t *workers = NULL;
+    size_t i, r, pos;
+    int t, err;
+
+    assert(0 < nthreads);
+    assert(!(flags & (HASHMAP_OPEN_ADDRESSING | HASHMAP_ORDERED |
+                      HASHMAP_INLINE_BUCKETS)));
+    h = hashmap_new_with_flags(hash, cmp, 1, flags | HASHMAP_POW2);
+    hashmap_reserve(h, n);
+
+    memset(&b, 0, sizeof(b));
+    if (n < MIN_PARALLEL)
+        goto put;
+
+    /* every thread gets enough entries to be worth starting */
+    if (n / MIN_PARALLEL < (size_t)nthreads)
+        nthreads = n / MIN_PARALLEL;
+
+    b.h = h;
+    b.entries = entries;
+    b.n = n;
+    b.nthreads = nthreads;
+    b.nranges = __roundup_pow2((size_t)nthreads * RANGES_PER_THREAD);
+    while (b.nranges < MAX_RANGES &&
+           RANGE_BYTES < h->arraySize / b.nranges * sizeof(node_t))
+        b.nranges *= 2;
+    if (h->arraySize < b.nranges)
+        b.nranges = h->arraySize;
+    while ((h->arraySize >> b.range_shift) > b.nranges)
+        b.range_shift++;
+    b.hashes = malloc(n * sizeof(unsigned long));
+    b.counts = calloc((size_t)nthreads * b.nranges, sizeof(size_t));
+    b.range_start = malloc((b.nranges + 1) * sizeof(size_t));
+    workers = calloc(nthreads, sizeof(worker_t));
+    if (!b.hashes || !b.counts || !b.range_start || !workers)
+        goto put;
+
+    for (t = 0; t < nthreads; t++)
+    {
+        workers[t].b = &b;
+        workers[t].idx = t;
+    }
+
+    __run(workers, sizeof(worker_t), nthreads, __count);
+
+    /* ranges are laid out one after another, and within a range each
+     * thread's entries come after those of the threads before it */
+    for (r = 0, pos = 0; r < b.nranges; r++)
+    {
+        b.range_start[r] = pos;
+        for (t = 0; t < nthreads; t++)
+        {
+            size_t count = b.counts[t * b.nranges + r];
+
+            b.counts[t * b.nranges + r] = pos;
+            pos += count;
+        }
+    }
+    b.range_start[b.nranges] = pos;
+    if (!(b.items = malloc(pos * sizeof(item_t))))
+        goto put;
+
+    __run(workers, sizeof(worker_t), nthreads, __scatter);
+    free(b.hashes);
+    err = __run(workers, sizeof(worker_t), nthreads, __fill);
+
+    /* the nodes filled in so far go with the map, even if it's freed */
+    __merge_nodes(h, workers, nthreads);
+
+    free(b.items);
+    free(b.counts);
+    free(b.range_start);
+    free(workers);
+    if (err)
+    {
+        hashmap_freeall(h);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return h;
+
+put:
+    /* too few entries to share out, or no memory to share them out with */
+    free(b.hashes);
+    free(b.counts);
+    free(b.range_start);
+    free(workers);
+    for (i = 0; i < n; i++)
+        hashmap_put(h, entries[i].key, entries[i].val);
+    return h;
+}
+
+void hashmap_for_each_parallel(
+    hashmap_t * h,
+    hashmap_for_each_f fn,
+    void **ctxs,
+    int nthreads
+    )
+{
+    walk_t wk;
+    walker_t *walkers;
+    int t;
+
+    assert(0 < nthreads);
+    wk.h = h;
+    wk.fn = fn;
+    wk.end = h->backend->range_end(h);
+    wk.next = 0;
+    wk.chunk = wk.end / ((size_t)nthreads * CHUNKS_PER_THREAD);
+    if (wk.chunk < MIN_CHUNK)
+        wk.chunk = MIN_CHUNK;
+
+    /* not enough to go round, so don't bother starting threads */
+    if (wk.end <= wk.chunk)
+        nthreads = 1;
+
+    /* without memory to share it out, walk it all here */
+    if (!(walkers = malloc(nthreads * sizeof(walker_t))))
+    {
+        h->backend->for_each_range(h, 0, wk.end, fn, ctxs ? ctxs[0] : NULL);
+        return;
+    }
+    for (t = 0; t < nthreads; t++)
+    {
+        walkers[t].wk = &wk;
+        walkers[t].ctx = ctxs ? ctxs[t] : NULL;
+    }
+    __run(walkers, sizeof(walker_t), nthreads, __walk);
+    free(walkers);
+}
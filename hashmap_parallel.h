@@ -0,0 +1,54 @@
+#ifndef HASHMAP_PARALLEL_H
+#define HASHMAP_PARALLEL_H
+
+#include "linked_list_hashmap.h"
+
+/**
+ * Doing the work of one whole map across many threads.
+ *
+ * The array is split into ranges of buckets. A thread that takes a range
+ * is the only one to touch those buckets and their chains, so no locks are
+ * needed.
+ */
+
+/**
+ * Build a chained map out of these entries, sharing the work out between
+ * threads. Comes out the same as putting the entries in order: a key that
+ * turns up again replaces the value, and entries with a NULL key or value
+ * are skipped. hash and cmp are called from many threads at once.
+ * @param nthreads : threads to use, counting the calling one; at least 1.
+ *                   No more than one for every few thousand entries are
+ *                   started. Work for a thread that can't be started, or
+ *                   runs out of memory, is done on the calling thread
+ * @param flags : HASHMAP_* flags. HASHMAP_POW2 is implied, and
+ *                HASHMAP_OPEN_ADDRESSING, HASHMAP_ORDERED and
+ *                HASHMAP_INLINE_BUCKETS aren't supported
+ * @return the map, which is then used like any other; otherwise NULL with
+ *         errno ENOMEM if its chain nodes couldn't be allocated */
+hashmap_t *hashmap_build_parallel(
+    func_longhash_f hash,
+    func_longcmp_f cmp,
+    const hashmap_entry_t * entries,
+    size_t n,
+    int nthreads,
+    int flags
+);
+
+/**
+ * Call fn on every entry of the map, with threads taking chunks of it in
+ * turn until the whole array has been walked. Works with any backend.
+ * Nothing may write to the map until this returns, though fn can change
+ * vals. Anything else fn wants to change, such as a running total or a
+ * list of keys to remove afterwards, goes in the thread's own ctx.
+ * @param ctxs : the ctx handed to fn by each thread, or NULL for none
+ * @param nthreads : threads to use, counting the calling one; at least 1,
+ *                   and ctxs holds this many. If a thread can't be
+ *                   started, the others walk its share of the chunks */
+void hashmap_for_each_parallel(
+    hashmap_t * h,
+    hashmap_for_each_f fn,
+    void **ctxs,
+    int nthreads
+);
+
+#endif /* HASHMAP_PARALLEL_H */
@@ -0,0 +1,462 @@
+/*
+
+   Copyright (c) 2011, Willem-Hendrik Thiart
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+ * The names of its contributors may not be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL WILLEM-HENDRIK THIART BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+
+/*
+ * Snapshot files are laid out as:
+ *
+ *  header
+ *  records   one for each entry, 8 byte aligned: the key and value lengths,
+ *            then the key bytes, then the value bytes
+ *  slots     open addressed with linear probing; each holds a key's hash
+ *            and its record's offset, where 0 is an empty slot
+ *
+ * The records are streamed out as the map is iterated, and the slots are
+ * built in memory and written after them. The header goes in last, so a
+ * file cut short never has a valid header.
+ *
+ * Only the header is checked when opening, so that opening stays cheap;
+ * snapshots are trusted not to have been tampered with.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "linked_list_hashmap.h"
+#include "hashmap_hashes.h"
+#include "hashmap_snapshot.h"
+
+#define MAGIC "HMSNAP\0\1"
+
+/* tells apart byte orders */
+#define BYTE_ORDER_MARK 0x0102030405060708ULL
+
+/* the slots are at most half full, which keeps probes short */
+#define SLOTS_PER_ENTRY 2
+
+/* records are small, so batch them up into big writes */
+#define WRITE_BUFFER_SIZE (1 << 20)
+
+/* hashmap_hash_bytes() seed for the keys; kept in the header so that it
+ * can change without breaking old files */
+#define SEED 0x9e3779b97f4a7c15ULL
+
+typedef struct
+{
+    char magic[8];
+    uint64_t byte_order;
+    uint64_t count;
+    /* a power of two */
+    uint64_t nslots;
+    uint64_t slots_offset;
+    uint64_t seed;
+    uint64_t file_size;
+} header_t;
+
+typedef struct
+{
+    uint32_t key_len;
+    uint32_t val_len;
+} record_t;
+
+typedef struct
+{
+    uint64_t hash;
+    uint64_t offset;
+} slot_t;
+
+struct hashmap_snapshot_s
+{
+    const uint8_t *data;
+    size_t size;
+    const header_t *header;
+    const slot_t *slots;
+};
+
+/**
+ * @return n rounded up to a multiple of 8 */
+inline static size_t __align8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+size_t hashmap_snapshot_encode_str(const void *obj, void *out, size_t len)
+{
+    size_t n = strlen(obj);
+
+    if (n <= len)
+        memcpy(out, obj, n);
+    return n;
+}
+
+size_t hashmap_snapshot_encode_uintptr(const void *obj, void *out, size_t len)
+{
+    unsigned long v = (unsigned long)obj;
+
+    if (sizeof(v) <= len)
+        memcpy(out, &v, sizeof(v));
+    return sizeof(v);
+}
+
+typedef struct
+{
+    uint8_t *data;
+    size_t size;
+} scratch_t;
+
+/**
+ * Encode into the scratch buffer, growing it if need be.
+ * @param len : receives the number of bytes encoded
+ * @return 0 on success, otherwise -1 with errno set */
+static int __encode(
+    hashmap_snapshot_encode_f encode,
+    const void *obj,
+    scratch_t * buf,
+    size_t *len
+    )
+{
+    size_t n = encode(obj, buf->data, buf->size);
+
+    if (buf->size < n)
+    {
+        uint8_t *data;
+
+        /* the old buffer stays with buf, to be freed as usual */
+        if (SIZE_MAX / 2 < n || !(data = realloc(buf->data, n * 2)))
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+        buf->data = data;
+        buf->size = n * 2;
+        encode(obj, buf->data, buf->size);
+    }
+    *len = n;
+    return 0;
+}
+
+/**
+ * Write bytes, then zeros up to a multiple of 8. */
+static int __write_padded(FILE * f, const void *data, size_t len)
+{
+    static const uint8_t zeros[8];
+
+    if (len != fwrite(data, 1, len, f))
+        return -1;
+    len = __align8(len) - len;
+    return len == fwrite(zeros, 1, len, f) ? 0 : -1;
+}
+
+/**
+ * Stream out a record for every entry, filling in its slot as we go.
+ * @return 0 on success, otherwise -1 */
+static int __write_records(
+    hashmap_t * h,
+    FILE * f,
+    hashmap_snapshot_encode_f encode_key,
+    hashmap_snapshot_encode_f encode_val,
+    header_t * hdr,
+    slot_t * slots
+    )
+{
+    scratch_t key = { NULL, 0 }, val = { NULL, 0 };
+    uint64_t offset = sizeof(header_t), mask = hdr->nslots - 1;
+    hashmap_iterator_t iter;
+    hashmap_entry_t *ety;
+    int err = 0;
+
+    hashmap_iterator(h, &iter);
+    while (!err && (ety = hashmap_iterator_next_entry(h, &iter)))
+    {
+        record_t r;
+        uint64_t hash, i;
+        size_t key_len, val_len;
+
+        if (__encode(encode_key, ety->key, &key, &key_len) ||
+            __encode(encode_val, ety->val, &val, &val_len))
+        {
+            err = -1;
+            break;
+        }
+        if (UINT32_MAX < key_len || UINT32_MAX < val_len)
+        {
+            errno = EOVERFLOW;
+            err = -1;
+            break;
+        }
+        r.key_len = key_len;
+        r.val_len = val_len;
+
+        /* keys are unique, so we only need a free slot */
+        hash = hashmap_hash_bytes(key.data, r.key_len, hdr->seed);
+        for (i = hash & mask; slots[i].offset; i = (i + 1) & mask)
+            ;
+        slots[i].hash = hash;
+        slots[i].offset = offset;
+
+        err = __write_padded(f, &r, sizeof(r)) ||
+            __write_padded(f, key.data, r.key_len) ||
+            __write_padded(f, val.data, r.val_len);
+        offset += sizeof(r) + __align8(r.key_len) + __align8(r.val_len);
+        hdr->count++;
+    }
+
+    hdr->slots_offset = offset;
+    free(key.data);
+    free(val.data);
+    return err ? -1 : 0;
+}
+
+/**
+ * Make a rename into the directory holding path survive a crash.
+ * @return 0 on success, otherwise -1 with errno set */
+static int __sync_dir(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    char *dir;
+    int fd, err;
+
+    if (!slash)
+        dir = strdup(".");
+    else if (slash == path)
+        dir = strdup("/");
+    else
+        dir = strndup(path, slash - path);
+    if (!dir)
+        return -1;
+
+    fd = open(dir, O_RDONLY);
+    free(dir);
+    if (-1 == fd)
+        return -1;
+    err = fsync(fd);
+    close(fd);
+    return err;
+}
+
+int hashmap_snapshot_write(
+    hashmap_t * h,
+    const char *path,
+    hashmap_snapshot_encode_f encode_key,
+    hashmap_snapshot_encode_f encode_val
+    )
+{
+    header_t hdr;
+    slot_t *slots;
+    char *tmp_path;
+    FILE *f;
+    int fd, err;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.byte_order = BYTE_ORDER_MARK;
+    hdr.seed = SEED;
+    hdr.nslots = 1;
+    while (hdr.nslots < hashmap_count(h) * SLOTS_PER_ENTRY)
+        hdr.nslots <<= 1;
+
+    if (!(slots = calloc(hdr.nslots, sizeof(slot_t))))
+        return -1;
+
+    /* Written to a file of its own next to path and renamed over, so
+     * that whoever has the old file mapped keeps on reading it, and two
+     * writers don't write over each other's half finished files. */
+    if (!(tmp_path = malloc(strlen(path) + sizeof(".XXXXXX"))))
+    {
+        free(slots);
+        return -1;
+    }
+    sprintf(tmp_path, "%s.XXXXXX", path);
+    if (-1 == (fd = mkstemp(tmp_path)))
+    {
+        free(tmp_path);
+        free(slots);
+        return -1;
+    }
+    /* mkstemp leaves it readable only by us */
+    if (fchmod(fd, 0644) || !(f = fdopen(fd, "wb")))
+    {
+        int e = errno;
+
+        close(fd);
+        unlink(tmp_path);
+        free(tmp_path);
+        free(slots);
+        errno = e;
+        return -1;
+    }
+    setvbuf(f, NULL, _IOFBF, WRITE_BUFFER_SIZE);
+
+    /* leave room for the header */
+    err = fseek(f, sizeof(header_t), SEEK_SET) ||
+        __write_records(h, f, encode_key, encode_val, &hdr, slots) ||
+        __write_padded(f, slots, hdr.nslots * sizeof(slot_t));
+    free(slots);
+
+    if (!err)
+    {
+        hdr.file_size = hdr.slots_offset + hdr.nslots * sizeof(slot_t);
+        memcpy(hdr.magic, MAGIC, sizeof(hdr.magic));
+        err = fflush(f) || fseek(f, 0, SEEK_SET) ||
+            __write_padded(f, &hdr, sizeof(hdr));
+    }
+
+    /* the data has to be on disk before the rename is, or a crash could
+     * leave a renamed but incomplete file */
+    if (!err)
+        err = fflush(f) || fsync(fileno(f));
+    if (fclose(f))
+        err = -1;
+    if (!err)
+        err = rename(tmp_path, path);
+    if (err)
+    {
+        int e = errno;
+
+        unlink(tmp_path);
+        errno = e;
+    }
+    else
+        err = __sync_dir(path);
+    free(tmp_path);
+    return err ? -1 : 0;
+}
+
+/**
+ * @return 1 if the header describes a snapshot that fits in size bytes */
+static int __header_valid(const header_t * hdr, size_t size)
+{
+    return size >= sizeof(header_t) &&
+        0 == memcmp(hdr->magic, MAGIC, sizeof(hdr->magic)) &&
+        BYTE_ORDER_MARK == hdr->byte_order &&
+        hdr->file_size == size &&
+        0 < hdr->nslots && 0 == (hdr->nslots & (hdr->nslots - 1)) &&
+        hdr->count < hdr->nslots &&
+        sizeof(header_t) <= hdr->slots_offset &&
+        0 == hdr->slots_offset % 8 &&
+        hdr->nslots <= (size - hdr->slots_offset) / sizeof(slot_t) &&
+        hdr->slots_offset + hdr->nslots * sizeof(slot_t) == size;
+}
+
+hashmap_snapshot_t *hashmap_snapshot_open(const char *path)
+{
+    hashmap_snapshot_t *snap;
+    struct stat st;
+    void *data;
+    int fd;
+
+    if (-1 == (fd = open(path, O_RDONLY)))
+        return NULL;
+
+    if (-1 == fstat(fd, &st))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    if ((size_t)st.st_size < sizeof(header_t))
+    {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    /* the mapping keeps the file open */
+    close(fd);
+    if (MAP_FAILED == data)
+        return NULL;
+
+    if (!__header_valid(data, st.st_size))
+    {
+        munmap(data, st.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (!(snap = malloc(sizeof(hashmap_snapshot_t))))
+    {
+        munmap(data, st.st_size);
+        errno = ENOMEM;
+        return NULL;
+    }
+    snap->data = data;
+    snap->size = st.st_size;
+    snap->header = data;
+    snap->slots = (const slot_t*)(snap->data + snap->header->slots_offset);
+    return snap;
+}
+
+void hashmap_snapshot_close(hashmap_snapshot_t * snap)
+{
+    munmap((void*)snap->data, snap->size);
+    free(snap);
+}
+
+size_t hashmap_snapshot_count(const hashmap_snapshot_t * snap)
+{
+    return snap->header->count;
+}
+
+const void *hashmap_snapshot_get(
+    const hashmap_snapshot_t * snap,
+    const void *key,
+    size_t key_len,
+    size_t *val_len
+    )
+{
+    uint64_t hash = hashmap_hash_bytes(key, key_len, snap->header->seed);
+    uint64_t mask = snap->header->nslots - 1, i;
+
+    /* at most half the slots are taken, so this finds an empty one */
+    for (i = hash & mask; snap->slots[i].offset; i = (i + 1) & mask)
+    {
+        const record_t *r;
+
+        if (snap->slots[i].hash != hash)
+            continue;
+
+        r = (const record_t*)(snap->data + snap->slots[i].offset);
+        if (r->key_len != key_len ||
+            0 != memcmp(r + 1, key, key_len))
+            continue;
+
+        if (val_len)
+            *val_len = r->val_len;
+        return (const uint8_t*)(r + 1) + __align8(key_len);
+    }
+
+    return NULL;
+}
@@ -0,0 +1,86 @@
+#ifndef HASHMAP_SNAPSHOT_H
+#define HASHMAP_SNAPSHOT_H
+
+#include <stddef.h>
+
+#include "linked_list_hashmap.h"
+
+/**
+ * A read-only copy of a map in a file, laid out so that it can be mmap'd
+ * and looked up in place.
+ *
+ * Keys and values are stored as bytes, turned out by encode functions, so
+ * the file holds no pointers. Opening a snapshot does no work for each
+ * entry; pages come off disk as lookups first touch them.
+ *
+ * Snapshots are only read back on machines with the same byte order and
+ * word size as the one that wrote them.
+ */
+typedef struct hashmap_snapshot_s hashmap_snapshot_t;
+
+/**
+ * Write out the bytes that stand for this key or value, like snprintf.
+ * @param out : where to write the bytes
+ * @param len : room in out, which might be 0
+ * @return how many bytes it takes, even if that is more than len, in which
+ *         case nothing needs to be written */
+typedef size_t (*hashmap_snapshot_encode_f)(
+    const void *obj,
+    void *out,
+    size_t len);
+
+/**
+ * NUL-terminated strings, without the NUL. */
+size_t hashmap_snapshot_encode_str(const void *obj, void *out, size_t len);
+
+/**
+ * Integers cast to pointers, as the bytes of an unsigned long. */
+size_t hashmap_snapshot_encode_uintptr(const void *obj, void *out, size_t len);
+
+/**
+ * Write every entry of this map to a snapshot file. The file is written
+ * to a temporary file next to path, synced, and renamed into place, so
+ * snapshots that have the old file open aren't disturbed and a crash
+ * leaves either the old file or the new one. The map must not be written to while this
+ * runs.
+ * @return 0 on success, otherwise -1 with errno set */
+int hashmap_snapshot_write(
+    hashmap_t * hmap,
+    const char *path,
+    hashmap_snapshot_encode_f encode_key,
+    hashmap_snapshot_encode_f encode_val
+);
+
+/**
+ * Map a snapshot file into memory.
+ * @return the snapshot, otherwise NULL with errno set; EINVAL if the file
+ *         isn't a snapshot this machine can read */
+hashmap_snapshot_t *hashmap_snapshot_open(
+    const char *path
+);
+
+/**
+ * Unmap the snapshot. Values it handed out are no longer valid. */
+void hashmap_snapshot_close(
+    hashmap_snapshot_t * snap
+);
+
+/**
+ * @return number of entries in the snapshot */
+size_t hashmap_snapshot_count(
+    const hashmap_snapshot_t * snap
+);
+
+/**
+ * Get the value of the key with these encoded bytes.
+ * @param val_len : if not NULL, receives the length of the value
+ * @return the value's bytes, which live as long as the snapshot is open
+ *         and are 8 byte aligned, otherwise NULL */
+const void *hashmap_snapshot_get(
+    const hashmap_snapshot_t * snap,
+    const void *key,
+    size_t key_len,
+    size_t *val_len
+);
+
+#endif /* HASHMAP_SNAPSHOT_H */
@@ -0,0 +1,514 @@
+/*
+
+   Copyright (c) 2011, Willem-Hendrik Thiart
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+ * The names of its contributors may not be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL WILLEM-HENDRIK THIART BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+
+/*
+ * Streams are laid out as:
+ *
+ *  magic     8 bytes
+ *  count     varint, number of entries
+ *  flags     varint, HASHMAP_STREAM_* flags
+ *  checksum  with HASHMAP_STREAM_CHECKSUM, 8 bytes over the above
+ *  chunks    each a varint length, then that many bytes of entries, then
+ *            with HASHMAP_STREAM_CHECKSUM the chunk's 8 byte checksum;
+ *            a chunk of length 0 ends the stream
+ *
+ * An entry is a varint key length, the key, a varint value length and the
+ * value. Entries never straddle chunks, so a chunk can be decoded on its
+ * own once it has been read and checked.
+ *
+ * A chunk's checksum is hashmap_hash_bytes() seeded with the chunk's
+ * number, so chunks that are swapped around don't pass either. The
+ * header's is seeded with HEADER_SEED. Integers outside varints are little
+ * endian.
+ *
+ * Without checksums the count in the header can't be trusted, so the map
+ * is only ever made big enough for as many entries as the bytes left in
+ * the stream could hold.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "linked_list_hashmap.h"
+#include "hashmap_hashes.h"
+#include "hashmap_stream.h"
+
+#define MAGIC "HMSTRM\0\1"
+
+/* entries are batched up into chunks of about this many bytes */
+#define CHUNK_SIZE (256 * 1024)
+
+/* most bytes a varint of 64 bits takes */
+#define VARINT_MAX 10
+
+#define HEADER_SIZE_MAX (8 + 2 * VARINT_MAX)
+
+#define HEADER_SEED UINT64_MAX
+
+/* fewest bytes an entry takes: two lengths of 0 */
+#define ENTRY_SIZE_MIN 2
+
+typedef struct
+{
+    uint8_t *data;
+    size_t size;
+} buf_t;
+
+/**
+ * Make sure the buffer can hold this many bytes, keeping what it has.
+ * @return 0 on success, otherwise -1 with errno set */
+static int __reserve(buf_t * b, size_t size)
+{
+    uint8_t *data;
+
+    if (size <= b->size)
+        return 0;
+
+    if (SIZE_MAX / 2 < size || !(data = realloc(b->data, size * 2)))
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    b->data = data;
+    b->size = size * 2;
+    return 0;
+}
+
+/**
+ * @return number of bytes written */
+static size_t __put_varint(uint8_t * out, uint64_t v)
+{
+    size_t n = 0;
+
+    while (0x80 <= v)
+    {
+        out[n++] = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+/**
+ * @return number of bytes read, otherwise 0 if the varint runs past end
+ * or is too long */
+static size_t __get_varint(const uint8_t * in, const uint8_t * end,
+                           uint64_t * v)
+{
+    size_t n;
+
+    *v = 0;
+    for (n = 0; n < VARINT_MAX && in + n < end; n++)
+    {
+        *v |= (uint64_t)(in[n] & 0x7f) << (7 * n);
+        if (!(in[n] & 0x80))
+            return n + 1;
+    }
+    return 0;
+}
+
+static int __write_varint(FILE * f, uint64_t v)
+{
+    uint8_t buf[VARINT_MAX];
+    size_t n = __put_varint(buf, v);
+
+    return n == fwrite(buf, 1, n, f) ? 0 : -1;
+}
+
+/**
+ * Read a varint from the stream, keeping its bytes in buf.
+ * @return number of bytes read, otherwise 0 with errno set */
+static size_t __read_varint(FILE * f, uint8_t * buf, uint64_t * v)
+{
+    size_t n;
+    int c;
+
+    for (n = 0; n < VARINT_MAX; n++)
+    {
+        if (EOF == (c = getc(f)))
+        {
+            if (!ferror(f))
+                errno = EBADMSG;
+            return 0;
+        }
+        buf[n] = c;
+        if (!(c & 0x80))
+            return __get_varint(buf, buf + n + 1, v);
+    }
+    errno = EBADMSG;
+    return 0;
+}
+
+static void __put_u64(uint8_t * out, uint64_t v)
+{
+    size_t i;
+
+    for (i = 0; i < 8; i++)
+        out[i] = v >> (8 * i);
+}
+
+static uint64_t __get_u64(const uint8_t * in)
+{
+    uint64_t v = 0;
+    size_t i;
+
+    for (i = 0; i < 8; i++)
+        v |= (uint64_t)in[i] << (8 * i);
+    return v;
+}
+
+void *hashmap_stream_decode_str(const void *data, size_t len)
+{
+    char *s = malloc(len + 1);
+
+    memcpy(s, data, len);
+    s[len] = '\0';
+    return s;
+}
+
+void *hashmap_stream_decode_uintptr(const void *data, size_t len)
+{
+    unsigned long v;
+
+    if (sizeof(v) != len)
+        return NULL;
+    memcpy(&v, data, sizeof(v));
+    return (void*)v;
+}
+
+/**
+ * Encode an object and its length into the chunk at pos.
+ * @return number of bytes taken, otherwise 0 if it doesn't fit */
+static size_t __encode_at(
+    hashmap_stream_encode_f encode,
+    const void *obj,
+    buf_t * chunk,
+    size_t pos
+    )
+{
+    uint8_t len_buf[VARINT_MAX];
+    size_t room = chunk->size - pos, len, n;
+
+    if (room < VARINT_MAX)
+        return 0;
+
+    /* most lengths take one byte, so encode after that and only move the
+     * bytes along for longer ones */
+    len = encode(obj, chunk->data + pos + 1, room - VARINT_MAX);
+    if (room - VARINT_MAX < len)
+        return 0;
+    n = __put_varint(len_buf, len);
+    if (1 < n)
+        memmove(chunk->data + pos + n, chunk->data + pos + 1, len);
+    memcpy(chunk->data + pos, len_buf, n);
+    return n + len;
+}
+
+/**
+ * Write out a chunk of this many bytes.
+ * @return 0 on success, otherwise -1 */
+static int __write_chunk(
+    FILE * f,
+    const buf_t * chunk,
+    size_t len,
+    uint64_t chunk_no,
+    int flags
+    )
+{
+    uint8_t sum[8];
+
+    if (__write_varint(f, len) || len != fwrite(chunk->data, 1, len, f))
+        return -1;
+
+    if (flags & HASHMAP_STREAM_CHECKSUM)
+    {
+        __put_u64(sum, hashmap_hash_bytes(chunk->data, len, chunk_no));
+        if (8 != fwrite(sum, 1, 8, f))
+            return -1;
+    }
+    return 0;
+}
+
+int hashmap_stream_write(
+    hashmap_t * h,
+    FILE * f,
+    hashmap_stream_encode_f encode_key,
+    hashmap_stream_encode_f encode_val,
+    int flags
+    )
+{
+    uint8_t hdr[HEADER_SIZE_MAX + 8];
+    buf_t chunk = { NULL, CHUNK_SIZE };
+    uint64_t chunk_no = 0;
+    size_t pos = 0, hdr_len;
+    hashmap_iterator_t iter;
+    hashmap_entry_t *ety;
+    int err;
+
+    if (!(chunk.data = malloc(chunk.size)))
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    memcpy(hdr, MAGIC, 8);
+    hdr_len = 8;
+    hdr_len += __put_varint(hdr + hdr_len, hashmap_count(h));
+    hdr_len += __put_varint(hdr + hdr_len, flags);
+    if (flags & HASHMAP_STREAM_CHECKSUM)
+    {
+        __put_u64(hdr + hdr_len, hashmap_hash_bytes(hdr, hdr_len, HEADER_SEED));
+        hdr_len += 8;
+    }
+    err = hdr_len != fwrite(hdr, 1, hdr_len, f);
+
+    hashmap_iterator(h, &iter);
+    while (!err && (ety = hashmap_iterator_next_entry(h, &iter)))
+    {
+        for (;;)
+        {
+            size_t k, v = 0;
+
+            if ((k = __encode_at(encode_key, ety->key, &chunk, pos)) &&
+                (v = __encode_at(encode_val, ety->val, &chunk, pos + k)))
+            {
+                pos += k + v;
+                break;
+            }
+
+            if (0 == pos)
+            {
+                uint8_t *data;
+
+                /* an entry bigger than a chunk gets a chunk to itself */
+                if (SIZE_MAX / 2 < chunk.size ||
+                    !(data = realloc(chunk.data, chunk.size * 2)))
+                {
+                    errno = ENOMEM;
+                    err = -1;
+                    break;
+                }
+                chunk.data = data;
+                chunk.size *= 2;
+            }
+            else if ((err = __write_chunk(f, &chunk, pos, chunk_no++, flags)))
+                break;
+            else
+                pos = 0;
+        }
+    }
+
+    if (!err && 0 < pos)
+        err = __write_chunk(f, &chunk, pos, chunk_no++, flags);
+    if (!err)
+        err = __write_varint(f, 0);
+
+    free(chunk.data);
+    return err ? -1 : 0;
+}
+
+/**
+ * Put every entry of this chunk into the map.
+ * @return 0 on success, otherwise -1 with errno set */
+static int __read_entries(
+    hashmap_t * h,
+    const uint8_t * in,
+    const uint8_t * end,
+    hashmap_stream_decode_f decode_key,
+    hashmap_stream_decode_f decode_val,
+    hashmap_stream_release_f release
+    )
+{
+    while (in < end)
+    {
+        uint64_t key_len, val_len;
+        const uint8_t *key;
+        void *k, *v, *v_prev;
+        size_t n;
+
+        if (!(n = __get_varint(in, end, &key_len)) ||
+            (uint64_t)(end - in - n) < key_len)
+            goto damaged;
+        key = in + n;
+        in = key + key_len;
+
+        if (!(n = __get_varint(in, end, &val_len)) ||
+            (uint64_t)(end - in - n) < val_len)
+            goto damaged;
+
+        if (!(k = decode_key(key, key_len)))
+            goto damaged;
+        if (!(v = decode_val(in + n, val_len)))
+        {
+            if (release)
+                release(k, NULL);
+            goto damaged;
+        }
+        in += n + val_len;
+
+        /* the map keeps the key it had, so ours goes with the old value */
+        if ((v_prev = hashmap_put(h, k, v)) && release)
+            release(k, v_prev);
+    }
+    return 0;
+
+damaged:
+    errno = EBADMSG;
+    return -1;
+}
+
+/**
+ * @return how many more entries the rest of this stream could hold, or 0
+ *         if it's not a file we can tell the size of */
+static uint64_t __entries_left(FILE * f)
+{
+    struct stat st;
+    long pos = ftell(f);
+
+    if (-1 == pos || fstat(fileno(f), &st) || !S_ISREG(st.st_mode) ||
+        st.st_size < pos)
+        return 0;
+    return (st.st_size - pos) / ENTRY_SIZE_MIN;
+}
+
+/**
+ * Make room for n entries, at most n_max, if they don't fit already.
+ * Like a put, this grows by at least grow_factor, so that a stream whose
+ * size we can't know resizes no more often than putting its entries. */
+static void __reserve_entries(hashmap_t * h, size_t n, size_t n_max)
+{
+    /* a put grows the map once the count reaches this */
+    double fits = h->grow_load * h->arraySize;
+    double grown = fits * h->grow_factor;
+
+    if ((double)n < fits)
+        return;
+    if ((double)n < grown)
+        n = (double)n_max < grown ? n_max : (size_t)grown;
+    hashmap_reserve(h, n < n_max ? n : n_max);
+}
+
+int hashmap_stream_read(
+    hashmap_t * h,
+    FILE * f,
+    hashmap_stream_decode_f decode_key,
+    hashmap_stream_decode_f decode_val,
+    hashmap_stream_release_f release
+    )
+{
+    uint8_t hdr[HEADER_SIZE_MAX], sum[8];
+    buf_t chunk = { NULL, 0 };
+    uint64_t count, flags, len, left, chunk_no = 0;
+    size_t hdr_len, n, count_max;
+    int err = 0;
+
+    if (8 != fread(hdr, 1, 8, f) || 0 != memcmp(hdr, MAGIC, 8))
+    {
+        if (!ferror(f))
+            errno = EINVAL;
+        return -1;
+    }
+    hdr_len = 8;
+
+    if (!(n = __read_varint(f, hdr + hdr_len, &count)))
+        return -1;
+    hdr_len += n;
+    if (!(n = __read_varint(f, hdr + hdr_len, &flags)))
+        return -1;
+    hdr_len += n;
+
+    if (flags & HASHMAP_STREAM_CHECKSUM)
+    {
+        if (8 != fread(sum, 1, 8, f) ||
+            __get_u64(sum) != hashmap_hash_bytes(hdr, hdr_len, HEADER_SEED))
+        {
+            if (!ferror(f))
+                errno = EBADMSG;
+            return -1;
+        }
+    }
+
+    /* most entries the map ends up with, if the count is right */
+    count_max = SIZE_MAX - hashmap_count(h) < count ?
+        SIZE_MAX : hashmap_count(h) + count;
+
+    /* no resizes while the entries go in, as long as the file is as big
+     * as the count says */
+    left = __entries_left(f);
+    hashmap_reserve(h, hashmap_count(h) + (left < count ? left : count));
+
+    while (!err)
+    {
+        size_t extra = flags & HASHMAP_STREAM_CHECKSUM ? 8 : 0;
+
+        if (!__read_varint(f, sum, &len))
+            err = -1;
+        else if (0 == len)
+            break;
+        else if (SIZE_MAX / 2 < len)
+        {
+            errno = EBADMSG;
+            err = -1;
+        }
+        else if (__reserve(&chunk, len + extra))
+            err = -1;
+        else if (len + extra != fread(chunk.data, 1, len + extra, f))
+        {
+            if (!ferror(f))
+                errno = EBADMSG;
+            err = -1;
+        }
+        else if (extra &&
+                 __get_u64(chunk.data + len) !=
+                 hashmap_hash_bytes(chunk.data, len, chunk_no))
+        {
+            errno = EBADMSG;
+            err = -1;
+        }
+        else
+        {
+            /* a count we couldn't check against the file's size only gets
+             * reserved as far as the entries this chunk could hold */
+            size_t most = hashmap_count(h) + len / ENTRY_SIZE_MIN;
+
+            __reserve_entries(h, most, count_max);
+            err = __read_entries(h, chunk.data, chunk.data + len,
+                                 decode_key, decode_val, release);
+        }
+        chunk_no++;
+    }
+
+    free(chunk.data);
+    return err ? -1 : 0;
+}
@@ -0,0 +1,96 @@
+#ifndef HASHMAP_STREAM_H
+#define HASHMAP_STREAM_H
+
+#include <stdio.h>
+
+#include "linked_list_hashmap.h"
+
+/**
+ * Checkpointing maps to a stdio stream and loading them back.
+ *
+ * Entries are written as varint length-prefixed keys and values, turned
+ * into bytes by encode functions and back by decode functions, and
+ * batched into large chunks. Each chunk can carry a checksum.
+ *
+ * Streams are read back on machines of any byte order, though what the
+ * codecs write is up to them.
+ */
+
+enum {
+    /* follow each chunk with a checksum, which reading verifies */
+    HASHMAP_STREAM_CHECKSUM = 1 << 0,
+};
+
+/**
+ * Write out the bytes that stand for this key or value, like snprintf.
+ * hashmap_snapshot_encode_str and hashmap_snapshot_encode_uintptr fit.
+ * @param out : where to write the bytes
+ * @param len : room in out, which might be 0
+ * @return how many bytes it takes, even if that is more than len, in which
+ *         case nothing needs to be written */
+typedef size_t (*hashmap_stream_encode_f)(
+    const void *obj,
+    void *out,
+    size_t len);
+
+/**
+ * Turn bytes written by an encode function back into a key or value.
+ * @return the key or value, otherwise NULL */
+typedef void *(*hashmap_stream_decode_f)(
+    const void *data,
+    size_t len);
+
+/**
+ * Hand back a decoded key and value that didn't end up in the map, either
+ * of which can be NULL. */
+typedef void (*hashmap_stream_release_f)(
+    void *key,
+    void *val);
+
+/**
+ * Decode into a malloc'd NUL-terminated string. */
+void *hashmap_stream_decode_str(const void *data, size_t len);
+
+/**
+ * Decode the bytes of an unsigned long into an integer cast to a
+ * pointer. */
+void *hashmap_stream_decode_uintptr(const void *data, size_t len);
+
+/**
+ * Write every entry of this map to the stream. The map must not be written
+ * to while this runs.
+ * @param flags : HASHMAP_STREAM_* flags
+ * @return 0 on success, otherwise -1 with errno set */
+int hashmap_stream_write(
+    hashmap_t * hmap,
+    FILE * f,
+    hashmap_stream_encode_f encode_key,
+    hashmap_stream_encode_f encode_val,
+    int flags
+);
+
+/**
+ * Put every entry of a stream written by hashmap_stream_write into this
+ * map. When reading from a file, the map is made big enough for all of
+ * them up front, so it doesn't resize as they go in. It is never made
+ * bigger than the rest of the stream could fill, whatever its header
+ * says.
+ * If this fails part of the way through, the entries read so far stay in
+ * the map.
+ * @param release : called on what the map doesn't keep. That is a key
+ *                  whose value failed to decode, and, for a key the map
+ *                  already had, the key just decoded and the value it
+ *                  replaced. NULL if nothing needs releasing, as with
+ *                  hashmap_stream_decode_uintptr
+ * @return 0 on success, otherwise -1 with errno set; EINVAL if the stream
+ *         isn't one, and EBADMSG if it is damaged or a checksum doesn't
+ *         match */
+int hashmap_stream_read(
+    hashmap_t * hmap,
+    FILE * f,
+    hashmap_stream_decode_f decode_key,
+    hashmap_stream_decode_f decode_val,
+    hashmap_stream_release_f release
+);
+
+#endif /* HASHMAP_STREAM_H */
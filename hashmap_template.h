@@ -0,0 +1,288 @@
+#ifndef HASHMAP_TEMPLATE_H
+#define HASHMAP_TEMPLATE_H
+
+/*
+ * Header-only maps specialised for one key and value type, khash style.
+ *
+ *   HASHMAP_INIT(intmap, uint64_t, double, hashmap_tpl_hash_u64,
+ *                HASHMAP_TPL_EQ)
+ *
+ * generates intmap_t and intmap_new(), intmap_put() and friends. Keys and
+ * values are stored by value, and hash and equality are macros or inline
+ * functions the compiler can see, so probing makes no indirect calls.
+ *
+ * The table is open addressing with linear probing. Each slot has a
+ * control byte that says whether it is empty, deleted or full, and keeps
+ * 7 bits of a full slot's hash so that most mismatches never compare
+ * keys. Any key value, including zero, can be stored.
+ *
+ * hash_fn(key) must return an unsigned long whose low and high bits are
+ * both well mixed; hashmap_tpl_hash_u64() does that for integers.
+ * eq_fn(a, b) must be nonzero when a equals b.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define HASHMAP_TPL_EMPTY 0x00
+#define HASHMAP_TPL_DELETED 0x01
+#define HASHMAP_TPL_FULL 0x80
+
+/* grow when full and deleted slots take up this much of the table */
+#define HASHMAP_TPL_MAX_LOAD 0.75
+
+#define HASHMAP_TPL_EQ(a, b) ((a) == (b))
+
+/**
+ * Integer hash, from MurmurHash3's finaliser. */
+static inline unsigned long hashmap_tpl_hash_u64(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+/**
+ * The types, on their own, for headers. */
+#define HASHMAP_TYPE(name, key_t, val_t) \
+    typedef struct \
+    { \
+        key_t key; \
+        val_t val; \
+    } name##_slot_t; \
+    \
+    typedef struct \
+    { \
+        size_t count; \
+        /* slots, always a power of two */ \
+        size_t size; \
+        size_t tombstones; \
+        uint8_t *ctrl; \
+        name##_slot_t *slots; \
+    } name##_t; \
+    \
+    typedef struct \
+    { \
+        size_t cur; \
+    } name##_iterator_t;
+
+/**
+ * Prototypes, for headers whose maps are defined in one .c file. */
+#define HASHMAP_PROTOTYPES(name, scope, key_t, val_t) \
+    scope name##_t *name##_new(size_t initial_capacity); \
+    scope void name##_freeall(name##_t * h); \
+    scope void name##_clear(name##_t * h); \
+    scope size_t name##_count(const name##_t * h); \
+    scope val_t *name##_get(name##_t * h, key_t key); \
+    scope int name##_put(name##_t * h, key_t key, val_t val); \
+    scope int name##_remove(name##_t * h, key_t key, val_t * val); \
+    scope void name##_reserve(name##_t * h, size_t n); \
+    scope void name##_iterator(name##_t * h, name##_iterator_t * iter); \
+    scope int name##_iterator_next(name##_t * h, name##_iterator_t * iter, \
+                                   key_t * key, val_t * val);
+
+/**
+ * The functions.
+ * @param scope : storage class for them, eg. "static inline" */
+#define HASHMAP_IMPL(name, scope, key_t, val_t, hash_fn, eq_fn) \
+    /** \
+     * @return control byte for a full slot with this hash */ \
+    static inline uint8_t name##__tag(unsigned long hash) \
+    { \
+        return HASHMAP_TPL_FULL | (hash >> (sizeof(unsigned long) * 8 - 7)); \
+    } \
+    \
+    static inline void name##__alloc(name##_t * h, size_t size) \
+    { \
+        h->size = size; \
+        /* zeroed control bytes are all HASHMAP_TPL_EMPTY */ \
+        h->ctrl = calloc(size, 1); \
+        h->slots = calloc(size, sizeof(name##_slot_t)); \
+        h->tombstones = 0; \
+    } \
+    \
+    /** \
+     * @return index of the slot holding this key, otherwise -1 */ \
+    static inline long name##__find(name##_t * h, key_t key, \
+                                    unsigned long hash) \
+    { \
+        size_t mask = h->size - 1, i = hash & mask; \
+        uint8_t tag = name##__tag(hash); \
+        \
+        for (;; i = (i + 1) & mask) \
+        { \
+            if (HASHMAP_TPL_EMPTY == h->ctrl[i]) \
+                return -1; \
+            if (tag == h->ctrl[i] && eq_fn(h->slots[i].key, key)) \
+                return i; \
+        } \
+    } \
+    \
+    /** \
+     * @return index of the first slot a new key with this hash can go in */ \
+    static inline size_t name##__find_free(name##_t * h, unsigned long hash) \
+    { \
+        size_t mask = h->size - 1, i = hash & mask; \
+        \
+        while (h->ctrl[i] & HASHMAP_TPL_FULL) \
+            i = (i + 1) & mask; \
+        return i; \
+    } \
+    \
+    static inline void name##__resize(name##_t * h, size_t size) \
+    { \
+        uint8_t *ctrl_old = h->ctrl; \
+        name##_slot_t *slots_old = h->slots; \
+        size_t i, size_old = h->size; \
+        \
+        name##__alloc(h, size); \
+        for (i = 0; i < size_old; i++) \
+        { \
+            size_t j; \
+            \
+            if (!(ctrl_old[i] & HASHMAP_TPL_FULL)) \
+                continue; \
+            /* keys are unique, so we only need a free slot */ \
+            j = name##__find_free(h, hash_fn(slots_old[i].key)); \
+            h->ctrl[j] = ctrl_old[i]; \
+            h->slots[j] = slots_old[i]; \
+        } \
+        free(ctrl_old); \
+        free(slots_old); \
+    } \
+    \
+    /** \
+     * @return fewest slots that hold n keys below the maximum load */ \
+    static inline size_t name##__fit_size(size_t n) \
+    { \
+        size_t size = 8; \
+        \
+        while (size * HASHMAP_TPL_MAX_LOAD <= n) \
+            size <<= 1; \
+        return size; \
+    } \
+    \
+    scope name##_t *name##_new(size_t initial_capacity) \
+    { \
+        name##_t *h = calloc(1, sizeof(name##_t)); \
+        \
+        name##__alloc(h, name##__fit_size(initial_capacity)); \
+        return h; \
+    } \
+    \
+    scope void name##_freeall(name##_t * h) \
+    { \
+        free(h->ctrl); \
+        free(h->slots); \
+        free(h); \
+    } \
+    \
+    scope void name##_clear(name##_t * h) \
+    { \
+        memset(h->ctrl, HASHMAP_TPL_EMPTY, h->size); \
+        h->count = 0; \
+        h->tombstones = 0; \
+    } \
+    \
+    scope size_t name##_count(const name##_t * h) \
+    { \
+        return h->count; \
+    } \
+    \
+    scope val_t *name##_get(name##_t * h, key_t key) \
+    { \
+        long i = name##__find(h, key, hash_fn(key)); \
+        \
+        return -1 == i ? NULL : &h->slots[i].val; \
+    } \
+    \
+    scope int name##_put(name##_t * h, key_t key, val_t val) \
+    { \
+        unsigned long hash = hash_fn(key); \
+        long i = name##__find(h, key, hash); \
+        size_t j; \
+        \
+        /* if same key, then we are just replacing val */ \
+        if (-1 != i) \
+        { \
+            h->slots[i].val = val; \
+            return 0; \
+        } \
+        \
+        if (h->size * HASHMAP_TPL_MAX_LOAD <= h->count + h->tombstones + 1) \
+            /* if it's mostly tombstones, sweeping them out is enough */ \
+            name##__resize(h, name##__fit_size(2 * (h->count + 1)) <= \
+                           h->size ? h->size : h->size * 2); \
+        \
+        j = name##__find_free(h, hash); \
+        if (HASHMAP_TPL_DELETED == h->ctrl[j]) \
+            h->tombstones--; \
+        h->ctrl[j] = name##__tag(hash); \
+        h->slots[j].key = key; \
+        h->slots[j].val = val; \
+        h->count++; \
+        return 1; \
+    } \
+    \
+    scope int name##_remove(name##_t * h, key_t key, val_t * val) \
+    { \
+        long i = name##__find(h, key, hash_fn(key)); \
+        \
+        if (-1 == i) \
+            return 0; \
+        if (val) \
+            *val = h->slots[i].val; \
+        \
+        /* a probe can stop at an empty slot, but not at a deleted one */ \
+        if (HASHMAP_TPL_EMPTY == h->ctrl[(i + 1) & (h->size - 1)]) \
+            h->ctrl[i] = HASHMAP_TPL_EMPTY; \
+        else \
+        { \
+            h->ctrl[i] = HASHMAP_TPL_DELETED; \
+            h->tombstones++; \
+        } \
+        h->count--; \
+        return 1; \
+    } \
+    \
+    scope void name##_reserve(name##_t * h, size_t n) \
+    { \
+        if (h->size < name##__fit_size(n)) \
+            name##__resize(h, name##__fit_size(n)); \
+    } \
+    \
+    scope void name##_iterator(name##_t * h __attribute__((unused)), \
+                               name##_iterator_t * iter) \
+    { \
+        iter->cur = 0; \
+    } \
+    \
+    scope int name##_iterator_next(name##_t * h, name##_iterator_t * iter, \
+                                   key_t * key, val_t * val) \
+    { \
+        /* slots never move when removing, so it's safe to remove */ \
+        for (; iter->cur < h->size; iter->cur++) \
+            if (h->ctrl[iter->cur] & HASHMAP_TPL_FULL) \
+            { \
+                if (key) \
+                    *key = h->slots[iter->cur].key; \
+                if (val) \
+                    *val = h->slots[iter->cur].val; \
+                iter->cur++; \
+                return 1; \
+            } \
+        return 0; \
+    }
+
+/**
+ * Types and functions in one go, private to the including file. */
+#define HASHMAP_INIT(name, key_t, val_t, hash_fn, eq_fn) \
+    HASHMAP_TYPE(name, key_t, val_t) \
+    HASHMAP_IMPL(name, static inline __attribute__((unused)), key_t, val_t, \
+                 hash_fn, eq_fn)
+
+#endif /* HASHMAP_TEMPLATE_H */
@@ -0,0 +1,32 @@
+#ifndef HASHMAP_UINT_H
+#define HASHMAP_UINT_H
+
+#include <stdint.h>
+
+#include "hashmap_template.h"
+
+/*
+ * A map from 64 bit integers to 64 bit integers, both held by value.
+ *
+ * hashmap_t can only hold non-NULL pointers, so integer keys and values
+ * either get cast to pointers, which rules out zero, or boxed on the
+ * heap. Here occupancy is kept in each slot's control byte instead, so
+ * zero is a valid key and a valid value, and a lookup only touches the
+ * table. Pointers fit in the values via uintptr_t.
+ *
+ * Generated by hashmap_template.h:
+ *   hashmap_uint_new(initial_capacity), hashmap_uint_freeall(h)
+ *   hashmap_uint_clear(h), hashmap_uint_count(h)
+ *   hashmap_uint_get(h, key) -> pointer to the value, otherwise NULL
+ *   hashmap_uint_put(h, key, val) -> 1 if key is new, 0 if replaced
+ *   hashmap_uint_remove(h, key, &val) -> 1 if removed, otherwise 0
+ *   hashmap_uint_reserve(h, n)
+ *   hashmap_uint_iterator(h, &iter),
+ *   hashmap_uint_iterator_next(h, &iter, &key, &val) -> 0 when done
+ */
+
+HASHMAP_TYPE(hashmap_uint, uint64_t, uint64_t)
+
+HASHMAP_PROTOTYPES(hashmap_uint, , uint64_t, uint64_t)
+
+#endif /* HASHMAP_UINT_H */
@@ -0,0 +1,443 @@
+/*
+
+   Copyright (c) 2011, Willem-Hendrik Thiart
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+ * The names of its contributors may not be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL WILLEM-HENDRIK THIART BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+
+/*
+ * Inline buckets backend.
+ *
+ * Every bucket is one 64 byte cache line holding up to BUCKET_SLOTS entries,
+ * each with a tag byte made of the top bits of its hash. A lookup checks
+ * the tags and only compares keys whose tag matches, so most lookups, and
+ * most collisions, are settled by the one line. When a bucket fills up it
+ * gets an overflow bucket of the same shape chained off it.
+ *
+ * There's no room left in the line for full hashes, so a resize hashes
+ * each key again.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "linked_list_hashmap.h"
+#include "linked_list_hashmap_private.h"
+
+#define CACHE_LINE 64
+
+#define BUCKET_SLOTS 3
+
+/* a slot with this tag is empty */
+#define TAG_EMPTY 0x00
+
+typedef struct bucket_s bucket_t;
+
+struct bucket_s
+{
+    uint8_t tags[BUCKET_SLOTS];
+    bucket_t *overflow;
+    hashmap_entry_t etys[BUCKET_SLOTS];
+} __attribute__((aligned(CACHE_LINE)));
+
+typedef char __bucket_fills_a_line[sizeof(bucket_t) == CACHE_LINE ? 1 : -1];
+
+inline static bucket_t *__buckets(hashmap_t * h)
+{
+    return h->array;
+}
+
+inline static bucket_t *__bucket(hashmap_t * h, unsigned long hash)
+{
+    return &__buckets(h)[hash & (h->arraySize - 1)];
+}
+
+/**
+ * The low bits of the hash pick the bucket, so the tag uses the top ones.
+ * @return tag for an entry with this hash, never TAG_EMPTY */
+inline static uint8_t __tag(unsigned long hash)
+{
+    return 0x80 | (hash >> (sizeof(unsigned long) * 8 - 7));
+}
+
+/**
+ * @return zeroed buckets, aligned to a cache line */
+static bucket_t *__bucket_alloc(size_t n)
+{
+    void *b;
+
+    if (0 != posix_memalign(&b, CACHE_LINE, n * sizeof(bucket_t)))
+        return NULL;
+    memset(b, 0, n * sizeof(bucket_t));
+    return b;
+}
+
+/**
+ * Free the overflow buckets chained off every bucket. */
+static void __free_overflow(hashmap_t * h)
+{
+    size_t i;
+
+    for (i = 0; i < h->arraySize; i++)
+    {
+        bucket_t *b = __buckets(h)[i].overflow;
+
+        while (b)
+        {
+            bucket_t *next = b->overflow;
+
+            free(b);
+            b = next;
+        }
+    }
+}
+
+/**
+ * @param probes : incremented for each bucket looked at
+ * @return the entry holding this key, otherwise NULL */
+static hashmap_entry_t *__find(
+    hashmap_t * h,
+    unsigned long hash,
+    const void *key,
+    size_t *probes
+    )
+{
+    uint8_t tag = __tag(hash);
+    bucket_t *b;
+
+    for (b = __bucket(h, hash); b; b = b->overflow)
+    {
+        int i;
+
+        (*probes)++;
+        for (i = 0; i < BUCKET_SLOTS; i++)
+            if (b->tags[i] == tag && 0 == h->compare(key, b->etys[i].key))
+                return &b->etys[i];
+    }
+    return NULL;
+}
+
+/**
+ * Take the first empty slot on this hash's chain, adding an overflow bucket
+ * if they are all full. Aborts if the overflow bucket can't be allocated.
+ * @return the slot's entry */
+static hashmap_entry_t *__take_slot(hashmap_t * h, unsigned long hash)
+{
+    bucket_t *b = __bucket(h, hash);
+    int i;
+
+    for (;; b = b->overflow)
+    {
+        for (i = 0; i < BUCKET_SLOTS; i++)
+            if (TAG_EMPTY == b->tags[i])
+            {
+                b->tags[i] = __tag(hash);
+                return &b->etys[i];
+            }
+        if (!b->overflow)
+            break;
+    }
+
+    /* a put has no way to say it failed, so don't carry on as if it hadn't */
+    if (!(b->overflow = __bucket_alloc(1)))
+        abort();
+    b = b->overflow;
+    b->tags[0] = __tag(hash);
+    return &b->etys[0];
+}
+
+static void __ib_alloc(hashmap_t * h)
+{
+    h->array = __bucket_alloc(h->arraySize);
+}
+
+static void __ib_free(hashmap_t * h)
+{
+    __free_overflow(h);
+    free(h->array);
+}
+
+static void __ib_clear(hashmap_t * h)
+{
+    __free_overflow(h);
+    memset(h->array, 0, h->arraySize * sizeof(bucket_t));
+    h->count = 0;
+}
+
+static hashmap_entry_t *__ib_get(
+    hashmap_t * h,
+    unsigned long hash,
+    const void *key
+    )
+{
+    size_t probes = 0;
+    hashmap_entry_t *ety = __find(h, hash, key, &probes);
+
+    __stat_lookup(h, probes, NULL != ety);
+    return ety;
+}
+
+static void *__ib_put(
+    hashmap_t * h,
+    unsigned long hash,
+    void *key,
+    void *val
+    )
+{
+    size_t probes = 0;
+    hashmap_entry_t *ety = __find(h, hash, key, &probes);
+
+    /* if same key, then we are just replacing val */
+    if (ety)
+    {
+        void *val_prev = ety->val;
+        ety->val = val;
+        return val_prev;
+    }
+
+    ety = __take_slot(h, hash);
+    ety->key = key;
+    ety->val = val;
+    h->count++;
+    return NULL;
+}
+
+static int __ib_remove(
+    hashmap_t * h,
+    unsigned long hash,
+    const void *key,
+    hashmap_entry_t * entry
+    )
+{
+    size_t probes = 0;
+    hashmap_entry_t *ety = __find(h, hash, key, &probes);
+    bucket_t *b;
+
+    if (!ety)
+        return 0;
+
+    memcpy(entry, ety, sizeof(hashmap_entry_t));
+
+    /* Entries don't move up to fill the slot, and an overflow bucket stays
+     * until the next resize or clear even once it's empty, so that
+     * iterators can carry on past a removal. */
+    b = (bucket_t*)((uintptr_t)ety & ~(uintptr_t)(CACHE_LINE - 1));
+    b->tags[ety - b->etys] = TAG_EMPTY;
+    h->count--;
+    return 1;
+}
+
+static void __ib_resize(hashmap_t * h, size_t size)
+{
+    bucket_t *array_old = h->array;
+    size_t i, size_old = h->arraySize;
+
+    h->arraySize = size;
+    __ib_alloc(h);
+
+    for (i = 0; i < size_old; i++)
+    {
+        bucket_t *b = &array_old[i], *next;
+
+        for (; b; b = next)
+        {
+            int j;
+
+            for (j = 0; j < BUCKET_SLOTS; j++)
+            {
+                hashmap_entry_t *ety;
+
+                if (TAG_EMPTY == b->tags[j])
+                    continue;
+
+                /* keys are unique, so we only need a free slot */
+                ety = __take_slot(h, __mix_hash(h->hash(b->etys[j].key)));
+                *ety = b->etys[j];
+            }
+
+            next = b->overflow;
+            if (b != &array_old[i])
+                free(b);
+        }
+    }
+
+    free(array_old);
+}
+
+static void __ib_prefetch(hashmap_t * h, unsigned long hash)
+{
+    __builtin_prefetch(__bucket(h, hash));
+}
+
+static void __ib_ensurecapacity(hashmap_t * h)
+{
+    if ((double)(h->count + 1) / h->arraySize < h->grow_load)
+        return;
+    hashmap_resize(h, __grown_size(h, h->grow_factor));
+}
+
+/**
+ * Iterators are at slot cur % BUCKET_SLOTS of bucket cur / BUCKET_SLOTS,
+ * or of the overflow bucket cur_linked chained off it.
+ * @return the bucket the iterator is in */
+static bucket_t *__iter_bucket(hashmap_t * h, hashmap_iterator_t * iter)
+{
+    if (iter->cur_linked)
+        return iter->cur_linked;
+    return &__buckets(h)[iter->cur / BUCKET_SLOTS];
+}
+
+/**
+ * Move the iterator on to the next slot. */
+static void __iter_step(hashmap_t * h, hashmap_iterator_t * iter)
+{
+    bucket_t *b = __iter_bucket(h, iter);
+
+    if (BUCKET_SLOTS - 1 != iter->cur % BUCKET_SLOTS)
+        iter->cur++;
+    else if (b->overflow)
+    {
+        iter->cur_linked = b->overflow;
+        iter->cur -= BUCKET_SLOTS - 1;
+    }
+    else
+    {
+        iter->cur_linked = NULL;
+        iter->cur++;
+    }
+}
+
+static hashmap_entry_t *__ib_iterator_peek(
+    hashmap_t * h,
+    hashmap_iterator_t * iter
+    )
+{
+    for (; iter->cur < h->arraySize * BUCKET_SLOTS; __iter_step(h, iter))
+    {
+        bucket_t *b = __iter_bucket(h, iter);
+
+        if (TAG_EMPTY != b->tags[iter->cur % BUCKET_SLOTS])
+            return &b->etys[iter->cur % BUCKET_SLOTS];
+    }
+    return NULL;
+}
+
+static hashmap_entry_t *__ib_iterator_next(
+    hashmap_t * h,
+    hashmap_iterator_t * iter
+    )
+{
+    hashmap_entry_t *ety = __ib_iterator_peek(h, iter);
+
+    /* entries never move when removing, so it's safe to step past */
+    if (ety)
+        __iter_step(h, iter);
+    return ety;
+}
+
+static size_t __ib_range_end(hashmap_t * h)
+{
+    return h->arraySize;
+}
+
+static void __ib_for_each_range(
+    hashmap_t * h,
+    size_t begin,
+    size_t end,
+    hashmap_for_each_f fn,
+    void *ctx
+    )
+{
+    size_t i;
+
+    for (i = begin; i < end; i++)
+    {
+        bucket_t *b;
+
+        for (b = &__buckets(h)[i]; b; b = b->overflow)
+        {
+            int j;
+
+            for (j = 0; j < BUCKET_SLOTS; j++)
+                if (TAG_EMPTY != b->tags[j])
+                    fn(&b->etys[j], ctx);
+        }
+    }
+}
+
+static void __ib_stats(hashmap_t * h, hashmap_stats_t * stats)
+{
+    size_t i, overflow = 0;
+
+    for (i = 0; i < h->arraySize; i++)
+    {
+        bucket_t *b;
+        size_t len;
+
+        /* each entry counts the cache lines a lookup for it visits */
+        for (b = &__buckets(h)[i], len = 1; b; b = b->overflow, len++)
+        {
+            int j;
+
+            if (1 < len)
+                overflow++;
+            for (j = 0; j < BUCKET_SLOTS; j++)
+            {
+                if (TAG_EMPTY == b->tags[j])
+                    continue;
+                __stat_chain(stats, len);
+                if (1 < len)
+                    stats->chained_nodes++;
+            }
+        }
+    }
+    stats->bytes = (h->arraySize + overflow) * sizeof(bucket_t);
+}
+
+const hashmap_backend_t hashmap_backend_inline_buckets = {
+    .alloc = __ib_alloc,
+    .free = __ib_free,
+    .clear = __ib_clear,
+    .get = __ib_get,
+    .put = __ib_put,
+    .remove = __ib_remove,
+    .prefetch = __ib_prefetch,
+    .ensurecapacity = __ib_ensurecapacity,
+    .resize = __ib_resize,
+    .iterator_peek = __ib_iterator_peek,
+    .iterator_next = __ib_iterator_next,
+    .range_end = __ib_range_end,
+    .for_each_range = __ib_for_each_range,
+    .stats = __ib_stats,
+    /* half the inline slots, so few buckets overflow */
+    .default_load = BUCKET_SLOTS / 2.0,
+    .min_size = 1,
+    .chains = 1,
+};
+
+/*--------------------------------------------------------------79-characters-*/
@@ -32,167 +32,314 @@
 #include <strings.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 
 #include "linked_list_hashmap.h"
+#include "linked_list_hashmap_private.h"
 
-/* when we call for more capacity */
-#define SPACERATIO 0.5
+/* occupied buckets each put moves along an incremental resize */
+#define REHASH_STEP 4
 
-typedef struct node_s node_t;
+/* empty buckets a step may skip for each occupied bucket it would move */
+#define REHASH_EMPTY_VISITS 10
 
-struct node_s
-{
-    hashmap_entry_t ety;
-    node_t *next;
-};
+/* keys hashed and prefetched ahead by hashmap_get_many/hashmap_put_many */
+#define BATCH_SIZE 16
+
+/* buckets ahead of itself a for_each prefetches chains for */
+#define FOR_EACH_PREFETCH 8
+
+/* bounds on how many chain nodes a slab grows the reservoir by */
+#define POOL_SLAB_MIN 32
+#define POOL_SLAB_MAX 4096
 
-static void __ensurecapacity(
+static void __rehash_done(
     hashmap_t * h
     );
 
 /**
- * Allocate memory for nodes. Used for chained nodes. */
+ * Allocate memory for nodes. Used for the array. */
 static node_t *__allocnodes(
-    unsigned int count
+    size_t count
     )
 {
-    // FIXME: make a chain node reservoir
     return calloc(count, sizeof(node_t));
 }
 
-hashmap_t *hashmap_new(
-    func_longhash_f hash,
-    func_longcmp_f cmp,
-    unsigned int initial_capacity
-    )
+/**
+ * Add a slab right after the one being carved, so that it is carved next. */
+static void __pool_add_slab(hashmap_t * h, size_t size)
 {
-    hashmap_t *h = calloc(1, sizeof(hashmap_t));
-    h->arraySize = initial_capacity;
-    h->array = __allocnodes(h->arraySize);
-    h->hash = hash;
-    h->compare = cmp;
-    return h;
-}
+    slab_t *s = malloc(sizeof(slab_t) + size * sizeof(node_t));
+    slab_t *cur = h->pool_slab_cur;
 
-int hashmap_count(const hashmap_t * h)
-{
-    return h->count;
+    s->size = size;
+    if (cur)
+    {
+        s->next = cur->next;
+        cur->next = s;
+    }
+    else
+    {
+        s->next = h->pool_slabs;
+        h->pool_slabs = s;
+    }
+    h->pool_capacity += size;
 }
 
-int hashmap_size(
-    hashmap_t * h
-    )
+/**
+ * Give every chain node back at once, without visiting them. */
+static void __pool_reset(hashmap_t * h)
 {
-    return h->arraySize;
+    slab_t *s = h->pool_slabs;
+
+    h->pool_free = NULL;
+    h->pool_slab_cur = s;
+    h->pool_slab_left = s ? s->size : 0;
+    h->pool_in_use = 0;
 }
 
 /**
- * free all the nodes in a chain, recursively. */
-static void __node_empty(hashmap_t * h, node_t * node)
+ * Take a chain node out of the reservoir. */
+static node_t *__node_alloc(hashmap_t * h)
 {
-    if (node)
+    node_t *n;
+
+    if (h->pool_free)
     {
-        __node_empty(h, node->next);
-        free(node);
-        h->count--;
+        n = h->pool_free;
+        h->pool_free = n->next;
     }
+    else
+    {
+        slab_t *s = h->pool_slab_cur;
+
+        if (0 == h->pool_slab_left)
+        {
+            /* move on to the next slab, making one if there isn't */
+            if (!(s ? s->next : h->pool_slabs))
+            {
+                /* grow in step with the map */
+                size_t size = h->pool_capacity;
+
+                if (size < POOL_SLAB_MIN)
+                    size = POOL_SLAB_MIN;
+                else if (POOL_SLAB_MAX < size)
+                    size = POOL_SLAB_MAX;
+                __pool_add_slab(h, size);
+            }
+
+            s = h->pool_slab_cur = s ? s->next : h->pool_slabs;
+            h->pool_slab_left = s->size;
+        }
+
+        n = &s->nodes[s->size - h->pool_slab_left];
+        h->pool_slab_left--;
+    }
+
+    h->pool_in_use++;
+    memset(n, 0, sizeof(node_t));
+    return n;
 }
 
-void hashmap_clear(hashmap_t * h)
+/**
+ * Give a chain node back to the reservoir. */
+static void __node_release(hashmap_t * h, node_t * n)
 {
-    int ii;
-
-    for (ii = 0; ii < h->arraySize; ii++)
-    {
-        node_t *node = &((node_t*)h->array)[ii];
+    n->next = h->pool_free;
+    h->pool_free = n;
+    h->pool_in_use--;
+}
 
-        if (NULL == node->ety.key)
-            continue;
+void hashmap_node_pool_reserve(hashmap_t * h, size_t nodes)
+{
+    size_t available = h->pool_capacity - h->pool_in_use;
 
-        /* normal actions will overwrite the value */
-        node->ety.key = NULL;
+    if (nodes <= available)
+        return;
 
-        /* empty and free this chain */
-        __node_empty(h, node->next);
-        node->next = NULL;
+    /* every slab is carved in turn, so the new one is reached before
+     * anything is allocated */
+    __pool_add_slab(h, nodes - available);
+}
 
-        h->count--;
-        assert(0 <= h->count);
+void hashmap_node_pool_stats(
+    const hashmap_t * h,
+    hashmap_node_pool_stats_t * stats
+    )
+{
+    const slab_t *s;
+
+    stats->capacity = h->pool_capacity;
+    stats->in_use = h->pool_in_use;
+    stats->available = h->pool_capacity - h->pool_in_use;
+    stats->slabs = 0;
+    stats->bytes = 0;
+    for (s = h->pool_slabs; s; s = s->next)
+    {
+        stats->slabs++;
+        stats->bytes += sizeof(slab_t) + s->size * sizeof(node_t);
     }
-
-    assert(0 == hashmap_count(h));
 }
 
-void hashmap_free(hashmap_t * h)
+/**
+ * Hash this key.
+ * In HASHMAP_POW2 mode only the low bits pick the bucket. */
+inline static unsigned long __hash(hashmap_t * h, const void *key)
 {
-    assert(h);
-    hashmap_clear(h);
-    free(h->array);
+    unsigned long hash = h->hash(key);
+
+    if (h->flags & HASHMAP_POW2)
+        hash = __mix_hash(hash);
+    return hash;
 }
 
-void hashmap_freeall(hashmap_t * h)
+static double __now(void)
 {
-    assert(h);
-    hashmap_free(h);
-    free(h);
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
 }
 
-inline static unsigned int __do_probe(hashmap_t * h, const void *key)
+inline static size_t __do_probe(
+    hashmap_t * h,
+    unsigned long hash,
+    size_t size
+    )
 {
-    return h->hash(key) % h->arraySize;
+    if (h->flags & HASHMAP_POW2)
+        return hash & (size - 1);
+    return hash % size;
 }
 
-void *hashmap_get(
+/**
+ * @return 1 if this node holds the key, otherwise 0 */
+inline static int __node_matches(
     hashmap_t * h,
+    const node_t * node,
+    unsigned long hash,
     const void *key
     )
 {
-    if (0 == hashmap_count(h) || !key)
-        return NULL;
+    /* only call compare when the hashes agree */
+    return node->hash == hash && 0 == h->compare(key, node->ety.key);
+}
+
+static void __chained_alloc(hashmap_t * h)
+{
+    h->array = __allocnodes(h->arraySize);
+}
+
+static void __chained_clear(hashmap_t * h)
+{
+    if (0 == h->count)
+        return;
+
+    /* nothing left to move, so the resize is done */
+    if (h->array_old)
+        __rehash_done(h);
+
+    /* every chain node is in the reservoir, so there is no need to walk
+     * the chains */
+    memset(h->array, 0, h->arraySize * sizeof(node_t));
+    __pool_reset(h);
+    h->count = 0;
+}
+
+static void __chained_free(hashmap_t * h)
+{
+    if (h->array_old)
+        __rehash_done(h);
+    free(h->array);
+
+    while (h->pool_slabs)
+    {
+        slab_t *s = h->pool_slabs;
+        h->pool_slabs = s->next;
+        free(s);
+    }
+    h->pool_capacity = 0;
+    __pool_reset(h);
+}
 
-    unsigned int probe = __do_probe(h, key);
-    node_t *node = &((node_t*)h->array)[probe];
+/**
+ * @param probes : incremented for each bucket or node looked at
+ * @return the node holding this key, otherwise NULL */
+static node_t *__find(
+    hashmap_t * h,
+    node_t * array,
+    size_t size,
+    unsigned long hash,
+    const void *key,
+    size_t *probes
+    )
+{
+    node_t *node = &array[__do_probe(h, hash, size)];
 
     if (NULL == node->ety.key)
+    {
+        (*probes)++;
         return NULL; /* we don't have this item */
+    }
     else
     {
         /* iterate down the node's linked list chain */
         do
-            if (0 == h->compare(key, node->ety.key))
-                return (void*)node->ety.val;
+        {
+            (*probes)++;
+            if (__node_matches(h, node, hash, key))
+                return node;
+        }
         while ((node = node->next));
     }
 
     return NULL;
 }
 
-int hashmap_contains_key(
+static hashmap_entry_t *__chained_get(
     hashmap_t * h,
+    unsigned long hash,
     const void *key
     )
 {
-    return NULL != hashmap_get(h, key);
+    node_t *node = NULL;
+    size_t probes = 0;
+
+    /* a resize might not have moved this key yet */
+    if (h->array_old)
+        node = __find(h, h->array_old, h->arraySize_old, hash, key, &probes);
+
+    if (!node)
+        node = __find(h, h->array, h->arraySize, hash, key, &probes);
+
+    __stat_lookup(h, probes, NULL != node);
+    return node ? &node->ety : NULL;
 }
 
-void hashmap_remove_entry(
+/**
+ * @return 1 if the key was removed from this array, otherwise 0 */
+static int __remove(
     hashmap_t * h,
-    hashmap_entry_t * entry,
-    const void *key
+    node_t * array,
+    size_t size,
+    unsigned long hash,
+    const void *key,
+    hashmap_entry_t * entry
     )
 {
     node_t *n, *n_parent;
 
-    n = &((node_t*)h->array)[__do_probe(h, key)];
+    n = &array[__do_probe(h, hash, size)];
 
     if (!n->ety.key)
-        goto notfound;
+        return 0;
 
     n_parent = NULL;
 
     do
     {
-        if (0 != h->compare(key, n->ety.key))
+        if (!__node_matches(h, n, hash, key))
         {
             /* does not match, traverse the chain.. */
             n_parent = n;
@@ -210,9 +357,10 @@ void hashmap_remove_entry(
             {
                 node_t *tmp = n->next;
                 memcpy(&n->ety, &tmp->ety, sizeof(hashmap_entry_t));
+                n->hash = tmp->hash;
                 /* Replace me with my next on chain */
                 n->next = tmp->next;
-                free(tmp);
+                __node_release(h, tmp);
             }
             else
                 /* un-assign */
@@ -222,30 +370,36 @@ void hashmap_remove_entry(
         {
             /* Replace me with my next on chain */
             n_parent->next = n->next;
-            free(n);
+            __node_release(h, n);
         }
 
         h->count--;
-        return;
+        return 1;
 
     }
     while (n);
 
-notfound:
-    entry->key = NULL;
-    entry->val = NULL;
+    return 0;
 }
 
-void *hashmap_remove(hashmap_t * h, const void *key)
+static int __chained_remove(
+    hashmap_t * h,
+    unsigned long hash,
+    const void *key,
+    hashmap_entry_t * entry
+    )
 {
-    hashmap_entry_t entry;
-    hashmap_remove_entry(h, &entry, key);
-    return (void*)entry.val;
+    if (h->array_old &&
+        __remove(h, h->array_old, h->arraySize_old, hash, key, entry))
+        return 1;
+
+    return __remove(h, h->array, h->arraySize, hash, key, entry);
 }
 
 inline static void __nodeassign(
     hashmap_t * h,
     node_t * node,
+    unsigned long hash,
     void *key,
     void *val
     )
@@ -254,36 +408,29 @@ inline static void __nodeassign(
     if (!node->ety.key)
         h->count++;
 
-    assert(h->count < 32768);
     node->ety.key = key;
     node->ety.val = val;
+    node->hash = hash;
 }
 
-void *hashmap_put(hashmap_t * h, void *key, void *val_new)
+/**
+ * Put using a hash we already know. Does not check capacity. */
+static void *__put(hashmap_t * h, unsigned long hash, void *key, void *val_new)
 {
-    if (!key || !val_new)
-        return NULL;
-
-    assert(key);
-    assert(val_new);
-    assert(h->array);
-
-    __ensurecapacity(h);
-
-    node_t *node = &((node_t*)h->array)[__do_probe(h, key)];
+    node_t *node = &((node_t*)h->array)[__do_probe(h, hash, h->arraySize)];
 
     assert(node);
 
     /* this one wasn't assigned */
     if (NULL == node->ety.key)
-        __nodeassign(h, node, key, val_new);
+        __nodeassign(h, node, hash, key, val_new);
     else
     {
         /* check the linked list */
         do
         {
             /* if same key, then we are just replacing val */
-            if (0 == h->compare(key, node->ety.key))
+            if (__node_matches(h, node, hash, key))
             {
                 void *val_prev = node->ety.val;
                 node->ety.val = val_new;
@@ -292,79 +439,201 @@ void *hashmap_put(hashmap_t * h, void *key, void *val_new)
         }
         while (node->next && (node = node->next));
 
-        node->next = __allocnodes(1);
-        __nodeassign(h, node->next, key, val_new);
+        node->next = __node_alloc(h);
+        __nodeassign(h, node->next, hash, key, val_new);
     }
 
     return NULL;
 }
 
-void hashmap_put_entry(hashmap_t * h, hashmap_entry_t * entry)
+/**
+ * Move one bucket of array_old over to the new array.
+ * Chain nodes are relinked instead of being reallocated. */
+static void __rehash_bucket(hashmap_t * h, size_t idx)
 {
-    hashmap_put(h, entry->key, entry->val);
-}
+    node_t *head = &((node_t*)h->array_old)[idx], *n, *to, *next;
 
-void hashmap_increase_capacity(hashmap_t * h, unsigned int factor)
-{
-    node_t *array_old;
-    int ii, asize_old;
+    if (NULL == head->ety.key)
+        return;
 
-    /*  stored old array */
-    array_old = h->array;
-    asize_old = h->arraySize;
+    for (n = head->next; n; n = next)
+    {
+        next = n->next;
+        to = &((node_t*)h->array)[__do_probe(h, n->hash, h->arraySize)];
 
-    /*  double array capacity */
-    h->arraySize *= factor;
-    h->array = __allocnodes(h->arraySize);
-    h->count = 0;
+        if (NULL == to->ety.key)
+        {
+            to->ety = n->ety;
+            to->hash = n->hash;
+            __node_release(h, n);
+        }
+        else
+        {
+            n->next = to->next;
+            to->next = n;
+        }
+    }
 
-    for (ii = 0; ii < asize_old; ii++)
+    /* the entry stored on the array needs a home too */
+    to = &((node_t*)h->array)[__do_probe(h, head->hash, h->arraySize)];
+    if (NULL == to->ety.key)
     {
-        node_t *node = &((node_t*)array_old)[ii];
+        to->ety = head->ety;
+        to->hash = head->hash;
+    }
+    else
+    {
+        n = __node_alloc(h);
+        n->ety = head->ety;
+        n->hash = head->hash;
+        n->next = to->next;
+        to->next = n;
+    }
 
-        /*  if key is null */
-        if (NULL == node->ety.key)
-            continue;
+    head->ety.key = NULL;
+    head->next = NULL;
+}
+
+static void __rehash_done(hashmap_t * h)
+{
+    free(h->array_old);
+    h->array_old = NULL;
+    h->arraySize_old = 0;
+    h->rehash_idx = 0;
+}
+
+/**
+ * Move what is left of an incremental resize in one go. */
+static void __rehash_finish(hashmap_t * h)
+{
+    for (; h->rehash_idx < h->arraySize_old; h->rehash_idx++)
+        __rehash_bucket(h, h->rehash_idx);
+    __rehash_done(h);
+}
 
-        hashmap_put(h, node->ety.key, node->ety.val);
+int hashmap_rehash_step(hashmap_t * h, size_t buckets)
+{
+    size_t empty_visits = buckets * REHASH_EMPTY_VISITS;
 
-        /* re-add chained hash nodes */
-        node = node->next;
+    while (h->array_old && 0 < buckets && 0 < empty_visits)
+    {
+        node_t *head = &((node_t*)h->array_old)[h->rehash_idx];
 
-        while (node)
+        if (head->ety.key)
         {
-            node_t *next = node->next;
-            hashmap_put(h, node->ety.key, node->ety.val);
-            assert(NULL != node->ety.key);
-            free(node);
-            node = next;
+            __rehash_bucket(h, h->rehash_idx);
+            buckets--;
         }
+        else
+            empty_visits--;
+
+        if (++h->rehash_idx == h->arraySize_old)
+            __rehash_done(h);
     }
 
-    free(array_old);
+    return NULL != h->array_old;
+}
+
+/**
+ * Swap in a bigger array, but leave the entries where they are. */
+static void __rehash_start(hashmap_t * h, size_t size)
+{
+    assert(!h->array_old);
+    h->array_old = h->array;
+    h->arraySize_old = h->arraySize;
+    h->rehash_idx = 0;
+    h->arraySize = size;
+    h->array = __allocnodes(h->arraySize);
+}
+
+static void *__chained_put(
+    hashmap_t * h,
+    unsigned long hash,
+    void *key,
+    void *val_new
+    )
+{
+    /* move this key's old bucket first, so that we won't end up with the
+     * key in both arrays */
+    if (h->array_old)
+        __rehash_bucket(h, __do_probe(h, hash, h->arraySize_old));
+
+    return __put(h, hash, key, val_new);
 }
 
-static void __ensurecapacity(hashmap_t * h)
+static void __chained_resize(hashmap_t * h, size_t size)
 {
-    if ((float)h->count / h->arraySize < SPACERATIO)
+    if (h->array_old)
+        __rehash_finish(h);
+
+    /* relink every node like an incremental resize does, but in one go.
+     * Keys are known to be unique, so there are no compares and no
+     * capacity checks. */
+    __rehash_start(h, size);
+    __rehash_finish(h);
+}
+
+static void __chained_prefetch(hashmap_t * h, unsigned long hash)
+{
+    if (h->array_old)
+        __builtin_prefetch(
+            &((node_t*)h->array_old)[__do_probe(h, hash, h->arraySize_old)]);
+    __builtin_prefetch(&((node_t*)h->array)[__do_probe(h, hash, h->arraySize)]);
+}
+
+static void __chained_ensurecapacity(hashmap_t * h)
+{
+    if (h->array_old)
+        hashmap_rehash_step(h, REHASH_STEP);
+
+    if ((double)h->count / h->arraySize < h->grow_load)
         return;
+    else if (h->flags & HASHMAP_INCREMENTAL)
+    {
+        double start = __now();
+
+        /* REHASH_STEP should see the last resize through before we need
+         * another one; if it didn't, finish it here */
+        if (h->array_old)
+            __rehash_finish(h);
+        __rehash_start(h, __grown_size(h, h->grow_factor));
+        h->stat_resizes++;
+        h->stat_resize_seconds += __now() - start;
+    }
     else
-        hashmap_increase_capacity(h, 2);
+        hashmap_resize(h, __grown_size(h, h->grow_factor));
 }
 
-void* hashmap_iterator_peek(
+/**
+ * Iterators walk what is left of array_old and then the array.
+ * @return the bucket at this iterator position */
+static node_t *__iter_bucket(hashmap_t * h, size_t pos)
+{
+    if (pos < h->arraySize_old)
+        return &((node_t*)h->array_old)[pos];
+    return &((node_t*)h->array)[pos - h->arraySize_old];
+}
+
+/**
+ * @return the iterator position past the last bucket */
+static size_t __iter_end(hashmap_t * h)
+{
+    return h->arraySize_old + h->arraySize;
+}
+
+static hashmap_entry_t *__chained_iterator_peek(
     hashmap_t * h,
     hashmap_iterator_t * iter
     )
 {
     if (NULL == iter->cur_linked)
     {
-        for (; iter->cur < h->arraySize; iter->cur++)
+        for (; iter->cur < __iter_end(h); iter->cur++)
         {
-            node_t *node = &((node_t*)h->array)[iter->cur];
+            node_t *node = __iter_bucket(h, iter->cur);
 
             if (node->ety.key)
-                return node->ety.key;
+                return &node->ety;
         }
 
         return NULL;
@@ -372,38 +641,21 @@ void* hashmap_iterator_peek(
     else
     {
         node_t *node = iter->cur_linked;
-        return node->ety.key;
+        return &node->ety;
     }
 }
 
-void* hashmap_iterator_peek_value(hashmap_t * h, hashmap_iterator_t * iter)
-{
-    return hashmap_get(h, hashmap_iterator_peek(h, iter));
-}
-
-int hashmap_iterator_has_next(hashmap_t * h, hashmap_iterator_t * iter)
-{
-    return NULL != hashmap_iterator_peek(h, iter);
-}
-
-void *hashmap_iterator_next_value(hashmap_t * h, hashmap_iterator_t * iter)
-{
-    void* k = hashmap_iterator_next(h, iter);
-    if (!k)
-        return NULL;
-    return hashmap_get(h, k);
-}
-
-void *hashmap_iterator_next(hashmap_t * h, hashmap_iterator_t * iter)
+static hashmap_entry_t *__chained_iterator_next(
+    hashmap_t * h,
+    hashmap_iterator_t * iter
+    )
 {
-    assert(iter);
-
     node_t *n = iter->cur_linked;
 
     /* if we have a node ready to look at on the chain.. */
     if (n)
     {
-        node_t *n_parent = &((node_t*)h->array)[iter->cur];
+        node_t *n_parent = __iter_bucket(h, iter->cur);
 
         /* check that we aren't following a dangling pointer.
          * There is a chance that cur_linked is now on the array. */
@@ -420,24 +672,24 @@ void *hashmap_iterator_next(hashmap_t * h, hashmap_iterator_t * iter)
                 iter->cur++;
             iter->cur_linked = n->next;
         }
-        return n->ety.key;
+        return &n->ety;
     }
     /*  otherwise check if we have a node to look at */
     else
     {
-        for (; iter->cur < h->arraySize; iter->cur++)
+        for (; iter->cur < __iter_end(h); iter->cur++)
         {
-            n = &((node_t*)h->array)[iter->cur];
+            n = __iter_bucket(h, iter->cur);
 
             if (n->ety.key)
                 break;
         }
 
         /*  exit if we are at the end */
-        if (h->arraySize == iter->cur)
+        if (__iter_end(h) == iter->cur)
             return NULL;
 
-        n = &((node_t*)h->array)[iter->cur];
+        n = __iter_bucket(h, iter->cur);
 
         if (n->next)
             iter->cur_linked = n->next;
@@ -448,8 +700,470 @@ void *hashmap_iterator_next(hashmap_t * h, hashmap_iterator_t * iter)
              *  if the node got placed on the array. */
             iter->cur += 1;
 
-        return n->ety.key;
+        return &n->ety;
+    }
+}
+
+/**
+ * Add the chains of this array, from bucket start on, to the stats. */
+static void __array_stats(
+    node_t * array,
+    size_t start,
+    size_t size,
+    hashmap_stats_t * stats)
+{
+    size_t ii;
+
+    for (ii = start; ii < size; ii++)
+    {
+        node_t *node = &array[ii];
+        size_t len = 0;
+
+        if (node->ety.key)
+            for (; node; node = node->next)
+                len++;
+        __stat_chain(stats, len);
+    }
+}
+
+static void __chained_for_each_range(
+    hashmap_t * h,
+    size_t begin,
+    size_t end,
+    hashmap_for_each_f fn,
+    void *ctx
+    )
+{
+    size_t pos;
+
+    for (pos = begin; pos < end; pos++)
+    {
+        node_t *node = __iter_bucket(h, pos);
+
+        /* chains are in the pool, away from the array, so start pulling
+         * in the one a few buckets on */
+        if (pos + FOR_EACH_PREFETCH < end)
+            __builtin_prefetch(__iter_bucket(h, pos + FOR_EACH_PREFETCH)->next);
+
+        /* an empty bucket has nothing chained off it */
+        if (!node->ety.key)
+            continue;
+        for (; node; node = node->next)
+            fn(&node->ety, ctx);
+    }
+}
+
+static void __chained_stats(hashmap_t * h, hashmap_stats_t * stats)
+{
+    hashmap_node_pool_stats_t pool;
+
+    /* buckets below rehash_idx have been moved and are empty */
+    if (h->array_old)
+        __array_stats(h->array_old, h->rehash_idx, h->arraySize_old, stats);
+    __array_stats(h->array, 0, h->arraySize, stats);
+
+    hashmap_node_pool_stats(h, &pool);
+    stats->chained_nodes = h->pool_in_use;
+    stats->bytes = (h->arraySize + h->arraySize_old) * sizeof(node_t) +
+        pool.bytes;
+}
+
+static const hashmap_backend_t __chained = {
+    .alloc = __chained_alloc,
+    .free = __chained_free,
+    .clear = __chained_clear,
+    .get = __chained_get,
+    .put = __chained_put,
+    .remove = __chained_remove,
+    .prefetch = __chained_prefetch,
+    .ensurecapacity = __chained_ensurecapacity,
+    .resize = __chained_resize,
+    .iterator_peek = __chained_iterator_peek,
+    .iterator_next = __chained_iterator_next,
+    .range_end = __iter_end,
+    .for_each_range = __chained_for_each_range,
+    .stats = __chained_stats,
+    /* when we call for more capacity */
+    .default_load = HASHMAP_CHAINED_LOAD,
+    .min_size = 1,
+    .chains = 1,
+};
+
+hashmap_t *hashmap_new_with_flags(
+    func_longhash_f hash,
+    func_longcmp_f cmp,
+    size_t initial_capacity,
+    int flags
+    )
+{
+    hashmap_t *h = calloc(1, sizeof(hashmap_t));
+
+    if (flags & HASHMAP_OPEN_ADDRESSING)
+    {
+        /* incremental resizing is only done by the chained backend */
+        assert(!(flags & (HASHMAP_INCREMENTAL | HASHMAP_ORDERED |
+                          HASHMAP_INLINE_BUCKETS)));
+        h->backend = &hashmap_backend_open_addressing;
+        flags |= HASHMAP_POW2;
+    }
+    else if (flags & HASHMAP_ORDERED)
+    {
+        assert(!(flags & (HASHMAP_INCREMENTAL | HASHMAP_INLINE_BUCKETS)));
+        h->backend = &hashmap_backend_ordered;
+        flags |= HASHMAP_POW2;
     }
+    else if (flags & HASHMAP_INLINE_BUCKETS)
+    {
+        assert(!(flags & HASHMAP_INCREMENTAL));
+        h->backend = &hashmap_backend_inline_buckets;
+        flags |= HASHMAP_POW2;
+    }
+    else
+        h->backend = &__chained;
+
+    h->flags = flags;
+    h->grow_load = h->backend->default_load;
+    h->grow_factor = 2;
+    h->shrink_load = 0;
+    h->arraySize = initial_capacity;
+    if (h->flags & HASHMAP_POW2)
+        h->arraySize = __roundup_pow2(h->arraySize);
+    h->backend->alloc(h);
+    h->hash = hash;
+    h->compare = cmp;
+    return h;
+}
+
+hashmap_t *hashmap_new(
+    func_longhash_f hash,
+    func_longcmp_f cmp,
+    size_t initial_capacity
+    )
+{
+    return hashmap_new_with_flags(hash, cmp, initial_capacity, 0);
+}
+
+size_t hashmap_count(const hashmap_t * h)
+{
+    return h->count;
+}
+
+size_t hashmap_size(
+    hashmap_t * h
+    )
+{
+    return h->arraySize;
+}
+
+void hashmap_clear(hashmap_t * h)
+{
+    h->backend->clear(h);
+    assert(0 == hashmap_count(h));
+}
+
+void hashmap_free(hashmap_t * h)
+{
+    assert(h);
+    /* no need to clear what is about to be freed */
+    h->backend->free(h);
+    h->count = 0;
+}
+
+void hashmap_freeall(hashmap_t * h)
+{
+    assert(h);
+    hashmap_free(h);
+    free(h);
+}
+
+void *hashmap_get(
+    hashmap_t * h,
+    const void *key
+    )
+{
+    if (0 == hashmap_count(h) || !key)
+        return NULL;
+
+    return hashmap_get_hashed(h, __hash(h, key), key);
+}
+
+void *hashmap_get_hashed(
+    hashmap_t * h,
+    unsigned long hash,
+    const void *key
+    )
+{
+    hashmap_entry_t *ety;
+
+    if (0 == hashmap_count(h))
+        return NULL;
+
+    ety = h->backend->get(h, hash, key);
+    return ety ? (void*)ety->val : NULL;
+}
+
+int hashmap_contains_key(
+    hashmap_t * h,
+    const void *key
+    )
+{
+    return NULL != hashmap_get(h, key);
+}
+
+/**
+ * @return fewest buckets that hold this many entries below this load */
+static size_t __fit_size(hashmap_t * h, size_t count, double load)
+{
+    double want = count / load + 1;
+    /* beyond what an array could ever hold, so the alloc will fail */
+    size_t size = (double)(SIZE_MAX / 2) < want ? SIZE_MAX / 2 : want;
+
+    if (size < h->backend->min_size)
+        size = h->backend->min_size;
+    if (h->flags & HASHMAP_POW2)
+        size = __roundup_pow2(size);
+    return size;
+}
+
+static void __remove_entry(
+    hashmap_t * h,
+    unsigned long hash,
+    hashmap_entry_t * entry,
+    const void *key
+    )
+{
+    if (h->backend->remove(h, hash, key, entry))
+    {
+        /* leave room to grow again, so that we don't flip-flop */
+        if ((double)h->count / h->arraySize < h->shrink_load &&
+            __fit_size(h, h->count, h->grow_load / 2) < h->arraySize)
+            hashmap_resize(h, __fit_size(h, h->count, h->grow_load / 2));
+        return;
+    }
+
+    entry->key = NULL;
+    entry->val = NULL;
+}
+
+void hashmap_remove_entry(
+    hashmap_t * h,
+    hashmap_entry_t * entry,
+    const void *key
+    )
+{
+    __remove_entry(h, __hash(h, key), entry, key);
+}
+
+void *hashmap_remove(hashmap_t * h, const void *key)
+{
+    hashmap_entry_t entry;
+    hashmap_remove_entry(h, &entry, key);
+    return (void*)entry.val;
+}
+
+void *hashmap_remove_hashed(
+    hashmap_t * h,
+    unsigned long hash,
+    const void *key
+    )
+{
+    hashmap_entry_t entry;
+    __remove_entry(h, hash, &entry, key);
+    return (void*)entry.val;
+}
+
+void *hashmap_put(hashmap_t * h, void *key, void *val_new)
+{
+    if (!key || !val_new)
+        return NULL;
+
+    return hashmap_put_hashed(h, __hash(h, key), key, val_new);
+}
+
+void *hashmap_put_hashed(
+    hashmap_t * h,
+    unsigned long hash,
+    void *key,
+    void *val_new
+    )
+{
+    assert(key);
+    assert(val_new);
+    assert(h->array);
+
+    h->backend->ensurecapacity(h);
+
+    return h->backend->put(h, hash, key, val_new);
+}
+
+void hashmap_put_entry(hashmap_t * h, hashmap_entry_t * entry)
+{
+    hashmap_put(h, entry->key, entry->val);
+}
+
+void hashmap_get_many(
+    hashmap_t * h,
+    const void **keys,
+    void **vals,
+    size_t n
+    )
+{
+    unsigned long hashes[BATCH_SIZE];
+    size_t i, j, batch;
+
+    for (i = 0; i < n; i += batch)
+    {
+        batch = n - i < BATCH_SIZE ? n - i : BATCH_SIZE;
+
+        /* get every bucket of the batch on its way into cache.. */
+        for (j = 0; j < batch; j++)
+        {
+            if (!keys[i + j])
+                continue;
+            hashes[j] = __hash(h, keys[i + j]);
+            h->backend->prefetch(h, hashes[j]);
+        }
+
+        /* ..before we look at any of them */
+        for (j = 0; j < batch; j++)
+        {
+            hashmap_entry_t *ety = NULL;
+
+            if (keys[i + j] && 0 < hashmap_count(h))
+                ety = h->backend->get(h, hashes[j], keys[i + j]);
+            vals[i + j] = ety ? ety->val : NULL;
+        }
+    }
+}
+
+void hashmap_put_many(
+    hashmap_t * h,
+    void **keys,
+    void **vals,
+    size_t n
+    )
+{
+    unsigned long hashes[BATCH_SIZE];
+    size_t i, j, batch;
+
+    for (i = 0; i < n; i += batch)
+    {
+        batch = n - i < BATCH_SIZE ? n - i : BATCH_SIZE;
+
+        for (j = 0; j < batch; j++)
+        {
+            if (!keys[i + j] || !vals[i + j])
+                continue;
+            hashes[j] = __hash(h, keys[i + j]);
+            h->backend->prefetch(h, hashes[j]);
+        }
+
+        for (j = 0; j < batch; j++)
+        {
+            if (!keys[i + j] || !vals[i + j])
+                continue;
+            /* a resize here only costs us the prefetch */
+            h->backend->ensurecapacity(h);
+            h->backend->put(h, hashes[j], keys[i + j], vals[i + j]);
+        }
+    }
+}
+
+void hashmap_resize(hashmap_t * h, size_t size)
+{
+    double start = __now();
+
+    h->backend->resize(h, size);
+    h->stat_resizes++;
+    h->stat_resize_seconds += __now() - start;
+}
+
+void hashmap_increase_capacity(hashmap_t * h, unsigned int factor)
+{
+    hashmap_resize(h, __grown_size(h, factor));
+}
+
+void hashmap_set_resize_policy(
+    hashmap_t * h,
+    double grow_load,
+    unsigned int grow_factor,
+    double shrink_load
+    )
+{
+    assert(0 < grow_load);
+    /* only chains can hold more entries than there are buckets */
+    assert(grow_load < 1 || h->backend->chains);
+    assert(2 <= grow_factor);
+    /* a map that has just grown mustn't be small enough to shrink */
+    assert(shrink_load < grow_load / grow_factor);
+
+    h->grow_load = grow_load;
+    h->grow_factor = grow_factor;
+    h->shrink_load = shrink_load;
+}
+
+void hashmap_shrink_to_fit(hashmap_t * h)
+{
+    size_t size = __fit_size(h, h->count, h->grow_load);
+
+    if (size < h->arraySize)
+        hashmap_resize(h, size);
+}
+
+void hashmap_reserve(hashmap_t * h, size_t n)
+{
+    size_t size = __fit_size(h, n, h->grow_load);
+
+    if (h->arraySize < size)
+        hashmap_resize(h, size);
+}
+
+void* hashmap_iterator_peek(
+    hashmap_t * h,
+    hashmap_iterator_t * iter
+    )
+{
+    hashmap_entry_t *ety = h->backend->iterator_peek(h, iter);
+
+    return ety ? ety->key : NULL;
+}
+
+void* hashmap_iterator_peek_value(hashmap_t * h, hashmap_iterator_t * iter)
+{
+    hashmap_entry_t *ety = h->backend->iterator_peek(h, iter);
+
+    return ety ? ety->val : NULL;
+}
+
+int hashmap_iterator_has_next(hashmap_t * h, hashmap_iterator_t * iter)
+{
+    return NULL != hashmap_iterator_peek(h, iter);
+}
+
+void *hashmap_iterator_next_value(hashmap_t * h, hashmap_iterator_t * iter)
+{
+    hashmap_entry_t *ety = hashmap_iterator_next_entry(h, iter);
+
+    return ety ? ety->val : NULL;
+}
+
+hashmap_entry_t *hashmap_iterator_next_entry(
+    hashmap_t * h,
+    hashmap_iterator_t * iter
+    )
+{
+    assert(iter);
+
+    return h->backend->iterator_next(h, iter);
+}
+
+void *hashmap_iterator_next(hashmap_t * h, hashmap_iterator_t * iter)
+{
+    assert(iter);
+
+    hashmap_entry_t *ety = h->backend->iterator_next(h, iter);
+
+    return ety ? ety->key : NULL;
 }
 
 void hashmap_iterator(
@@ -461,4 +1175,42 @@ void hashmap_iterator(
     iter->cur_linked = NULL;
 }
 
+size_t hashmap_range_end(hashmap_t * h)
+{
+    return h->backend->range_end(h);
+}
+
+void hashmap_for_each_range(
+    hashmap_t * h,
+    size_t begin,
+    size_t end,
+    hashmap_for_each_f fn,
+    void *ctx
+    )
+{
+    size_t last = h->backend->range_end(h);
+
+    if (last < end)
+        end = last;
+    if (begin < end)
+        h->backend->for_each_range(h, begin, end, fn, ctx);
+}
+
 /*--------------------------------------------------------------79-characters-*/
+
+void hashmap_get_stats(hashmap_t * h, hashmap_stats_t * stats)
+{
+    memset(stats, 0, sizeof(hashmap_stats_t));
+    h->backend->stats(h, stats);
+    stats->bytes += sizeof(hashmap_t);
+    stats->resizes = h->stat_resizes;
+    stats->resize_seconds = h->stat_resize_seconds;
+    stats->lookups = __atomic_load_n(&h->stat_lookups, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&h->stat_misses, __ATOMIC_RELAXED);
+    if (stats->lookups)
+        stats->probes_per_lookup = (double)__atomic_load_n(
+            &h->stat_lookup_probes, __ATOMIC_RELAXED) / stats->lookups;
+    if (stats->misses)
+        stats->probes_per_miss = (double)__atomic_load_n(
+            &h->stat_miss_probes, __ATOMIC_RELAXED) / stats->misses;
+}
@@ -1,6 +1,8 @@
 #ifndef LINKED_LIST_HASHMAP_H
 #define LINKED_LIST_HASHMAP_H
 
+#include <stddef.h>
+
 typedef unsigned long (*func_longhash_f) (const void *);
 
 typedef long (*func_longcmp_f) (const void *, const void *);
@@ -11,39 +13,161 @@ typedef struct
     void *val;
 } hashmap_entry_t;
 
+/* flags for hashmap_new_with_flags() */
+enum
+{
+    /* Keep the array size a power of two, and find buckets with a mask
+     * instead of a modulo. Hashes get mixed so that weak hashes still
+     * spread across the buckets. */
+    HASHMAP_POW2 = 1 << 0,
+
+    /* Spread resizes over many puts instead of moving every entry in one
+     * go. Until a resize has finished both arrays are kept, and gets,
+     * removes and iterators look in both. */
+    HASHMAP_INCREMENTAL = 1 << 1,
+
+    /* Instead of chaining, keep entries in the array itself and probe for
+     * them a group of 16 slots at a time, Swiss table style. Implies
+     * HASHMAP_POW2; resizes are never incremental. */
+    HASHMAP_OPEN_ADDRESSING = 1 << 2,
+
+    /* Keep entries in one dense array in the order they were put, with the
+     * array holding only indices into it, like Python's compact dict.
+     * Iterators follow insertion order. Implies HASHMAP_POW2; resizes are
+     * never incremental. */
+    HASHMAP_ORDERED = 1 << 3,
+
+    /* Make each bucket one 64 byte cache line holding three entries and a
+     * tag byte for each, with further buckets chained off it once it's
+     * full, so that most lookups touch a single line. Implies
+     * HASHMAP_POW2; resizes are never incremental. */
+    HASHMAP_INLINE_BUCKETS = 1 << 4,
+};
+
+typedef struct hashmap_backend_s hashmap_backend_t;
+
 typedef struct
 {
-    int count;
-    int arraySize;
+    size_t count;
+    size_t arraySize;
     void *array;
     func_longhash_f hash;
     func_longcmp_f compare;
+    int flags;
+
+    /* how the array is laid out, picked by hashmap_new_with_flags() */
+    const hashmap_backend_t *backend;
+
+    /* see hashmap_set_resize_policy() */
+    double grow_load;
+    unsigned int grow_factor;
+    double shrink_load;
+
+    /* with HASHMAP_OPEN_ADDRESSING, slots marked as deleted */
+    size_t tombstones;
+
+    /* with HASHMAP_INCREMENTAL, the array a resize is moving away from */
+    void *array_old;
+    size_t arraySize_old;
+    /* buckets of array_old below this have been moved */
+    size_t rehash_idx;
+
+    /* reservoir of chain nodes, so that collisions don't hit malloc */
+    void *pool_free;
+    void *pool_slabs;
+    /* slab nodes are being carved out of, and how many it has left */
+    void *pool_slab_cur;
+    size_t pool_slab_left;
+    size_t pool_capacity;
+    size_t pool_in_use;
+
+    /* see hashmap_get_stats() */
+    size_t stat_lookups;
+    size_t stat_lookup_probes;
+    size_t stat_misses;
+    size_t stat_miss_probes;
+    size_t stat_resizes;
+    double stat_resize_seconds;
 } hashmap_t;
 
 typedef struct
 {
-    int cur;
+    /* chain nodes carved out of the reservoir's slabs */
+    size_t capacity;
+    /* chain nodes currently linked into the map */
+    size_t in_use;
+    /* chain nodes that can be handed out without allocating */
+    size_t available;
+    size_t slabs;
+    /* memory held by the reservoir */
+    size_t bytes;
+} hashmap_node_pool_stats_t;
+
+/* chain lengths hashmap_get_stats() tells apart; longer ones share the
+ * last */
+#define HASHMAP_STATS_CHAINS 16
+
+typedef struct
+{
+    /* With chaining, how many buckets hold each number of entries. With
+     * HASHMAP_OPEN_ADDRESSING or HASHMAP_ORDERED, how many entries are
+     * found after visiting each number of groups or slots, and with
+     * HASHMAP_INLINE_BUCKETS after visiting each number of cache lines. */
+    size_t chains[HASHMAP_STATS_CHAINS];
+    size_t max_chain;
+    /* entries that are not in their first bucket, group or slot */
+    size_t chained_nodes;
+    size_t resizes;
+    /* an incremental resize only counts the time taken to start it */
+    double resize_seconds;
+    /* memory held by the map, including the map itself */
+    size_t bytes;
+    /* Gets, and the buckets, chain nodes, groups or slots they looked at.
+     * These are only counted when built with HASHMAP_STATS defined,
+     * otherwise they are 0. They are counted atomically, so gets from
+     * many threads at once are still safe, at some cost to each get. */
+    size_t lookups;
+    size_t misses;
+    double probes_per_lookup;
+    double probes_per_miss;
+} hashmap_stats_t;
+
+typedef struct
+{
+    size_t cur;
     void *cur_linked;
 } hashmap_iterator_t;
 
 hashmap_t *hashmap_new(
     func_longhash_f hash,
     func_longcmp_f cmp,
-    unsigned int initial_capacity
+    size_t initial_capacity
+);
+
+/**
+ * @param flags : bitwise OR of HASHMAP_* flags */
+hashmap_t *hashmap_new_with_flags(
+    func_longhash_f hash,
+    func_longcmp_f cmp,
+    size_t initial_capacity,
+    int flags
 );
 
 /**
  * @return number of items within hash */
-int hashmap_count(const hashmap_t * hmap);
+size_t hashmap_count(const hashmap_t * hmap);
 
 /**
  * @return size of the array used within hash */
-int hashmap_size(
+size_t hashmap_size(
     hashmap_t * hmap
 );
 
 /**
- * Empty this hash. */
+ * Empty this hash.
+ * Keeps the array and the chain node reservoir, so that refilling it
+ * doesn't allocate. Takes time in proportion to the array's size, not
+ * to how many entries there are. */
 void hashmap_clear(
     hashmap_t * hmap
 );
@@ -110,6 +234,28 @@ void hashmap_put_entry(
     hashmap_entry_t * entry
 );
 
+/**
+ * Get the values of many keys.
+ * Keys are hashed and their buckets prefetched a batch at a time, so that
+ * the cache misses of one key overlap with the work on the others.
+ * @param vals : receives each key's value, otherwise NULL */
+void hashmap_get_many(
+    hashmap_t * hmap,
+    const void **keys,
+    void **vals,
+    size_t n
+);
+
+/**
+ * Associate each key with its val, prefetching like hashmap_get_many.
+ * NULL keys or vals are skipped, like hashmap_put. */
+void hashmap_put_many(
+    hashmap_t * hmap,
+    void **keys,
+    void **vals,
+    size_t n
+);
+
 void* hashmap_iterator_peek(
     hashmap_t * hmap,
     hashmap_iterator_t * iter);
@@ -138,6 +284,15 @@ void *hashmap_iterator_next_value(
     hashmap_t * hmap,
     hashmap_iterator_t * iter);
 
+/**
+ * Iterate to the next item on a hash iterator, without looking it up again.
+ * The entry is the map's own; it stays valid until the map is next
+ * written to, and its key must not be changed.
+ * @return next entry from iterator, otherwise NULL */
+hashmap_entry_t *hashmap_iterator_next_entry(
+    hashmap_t * hmap,
+    hashmap_iterator_t * iter);
+
 /**
  * Initialise a new hash iterator over this hash
  * It is safe to remove items while iterating.  */
@@ -146,6 +301,31 @@ void hashmap_iterator(
     hashmap_iterator_t * iter
 );
 
+/**
+ * Called on each entry by hashmap_for_each_range. The val can be changed,
+ * but not the key, and the map must not be put to or removed from. */
+typedef void (*hashmap_for_each_f)(hashmap_entry_t * ety, void *ctx);
+
+/**
+ * @return the end of the positions hashmap_for_each_range takes. Positions
+ *         are buckets, slots or, for HASHMAP_ORDERED, entries */
+size_t hashmap_range_end(
+    hashmap_t * hmap
+);
+
+/**
+ * Call fn on every entry at positions begin up to end. Ranges that don't
+ * overlap can be walked by different threads at once, as long as nothing
+ * writes to the map meanwhile.
+ * @param end : hashmap_range_end() for the rest of the map */
+void hashmap_for_each_range(
+    hashmap_t * hmap,
+    size_t begin,
+    size_t end,
+    hashmap_for_each_f fn,
+    void *ctx
+);
+
 /**
  * Increase hash capacity.
  * @param factor : increase by this factor */
@@ -153,4 +333,69 @@ void hashmap_increase_capacity(
     hashmap_t * hmap,
     unsigned int factor);
 
+/**
+ * Move occupied buckets of an unfinished HASHMAP_INCREMENTAL resize over
+ * to the new array. Puts do this on their own; this lets idle time help.
+ * Like a put, this invalidates iterators.
+ * @param buckets : most occupied buckets to move
+ * @return 1 if the resize still has buckets left to move, otherwise 0 */
+int hashmap_rehash_step(
+    hashmap_t * hmap,
+    size_t buckets);
+
+/**
+ * Make room for this many entries in total, so that putting them won't
+ * resize. The array is resized at most once. Like a put, this
+ * invalidates iterators.
+ * @param n : number of entries to make room for */
+void hashmap_reserve(
+    hashmap_t * hmap,
+    size_t n);
+
+/**
+ * Tune when the array grows and shrinks.
+ * If shrinking is on, a remove can resize the array, so it is no longer
+ * safe to remove items while iterating.
+ * @param grow_load : grow before a put once count / size reaches this.
+ *                    0.5 by default and 1.5 with HASHMAP_INLINE_BUCKETS;
+ *                    0.875 with HASHMAP_OPEN_ADDRESSING and 2/3 with
+ *                    HASHMAP_ORDERED, which both need it below 1
+ * @param grow_factor : multiply size by this when growing. 2 by default
+ * @param shrink_load : after a remove, shrink once count / size is below
+ *                      this, down to half of grow_load. 0, the default,
+ *                      never shrinks. Must be below
+ *                      grow_load / grow_factor */
+void hashmap_set_resize_policy(
+    hashmap_t * hmap,
+    double grow_load,
+    unsigned int grow_factor,
+    double shrink_load);
+
+/**
+ * Shrink the array down to the smallest size that holds the entries
+ * below grow_load. Like a put, this invalidates iterators. */
+void hashmap_shrink_to_fit(
+    hashmap_t * hmap);
+
+/**
+ * Make sure the chain node reservoir can hand out this many more nodes
+ * without allocating.
+ * @param nodes : number of chain nodes to have available */
+void hashmap_node_pool_reserve(
+    hashmap_t * hmap,
+    size_t nodes);
+
+/**
+ * Report how much of the chain node reservoir is being used. */
+void hashmap_node_pool_stats(
+    const hashmap_t * hmap,
+    hashmap_node_pool_stats_t * stats);
+
+/**
+ * Report how well keys are spread out, and what lookups and resizes have
+ * cost so far. Walks the whole array. */
+void hashmap_get_stats(
+    hashmap_t * hmap,
+    hashmap_stats_t * stats);
+
 #endif /* LINKED_LIST_HASHMAP_H */
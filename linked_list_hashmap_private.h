@@ -0,0 +1,229 @@
+#ifndef LINKED_LIST_HASHMAP_PRIVATE_H
+#define LINKED_LIST_HASHMAP_PRIVATE_H
+
+#include <limits.h>
+#include <stdint.h>
+
+/**
+ * What a way of laying out the array needs to provide.
+ * Hashes handed to these have already been mixed for HASHMAP_POW2, and
+ * keys are never NULL. */
+struct hashmap_backend_s
+{
+    /**
+     * Allocate an empty hmap->array of hmap->arraySize buckets. */
+    void (*alloc)(hashmap_t * hmap);
+
+    /**
+     * Free the array and anything the entries hold on to. */
+    void (*free)(hashmap_t * hmap);
+
+    void (*clear)(hashmap_t * hmap);
+
+    /**
+     * @return the entry holding this key, otherwise NULL */
+    hashmap_entry_t *(*get)(
+        hashmap_t * hmap,
+        unsigned long hash,
+        const void *key);
+
+    /**
+     * Does not check capacity.
+     * @return previous associated val; otherwise NULL */
+    void *(*put)(
+        hashmap_t * hmap,
+        unsigned long hash,
+        void *key,
+        void *val);
+
+    /**
+     * @return 1 if the key was removed and copied to entry, otherwise 0 */
+    int (*remove)(
+        hashmap_t * hmap,
+        unsigned long hash,
+        const void *key,
+        hashmap_entry_t * entry);
+
+    /**
+     * Start pulling the bucket this hash lives in into cache. */
+    void (*prefetch)(hashmap_t * hmap, unsigned long hash);
+
+    /**
+     * Called before every put, to grow the array if need be. */
+    void (*ensurecapacity)(hashmap_t * hmap);
+
+    /**
+     * Move every entry into a new array of this many buckets. */
+    void (*resize)(hashmap_t * hmap, size_t size);
+
+    hashmap_entry_t *(*iterator_peek)(
+        hashmap_t * hmap,
+        hashmap_iterator_t * iter);
+
+    hashmap_entry_t *(*iterator_next)(
+        hashmap_t * hmap,
+        hashmap_iterator_t * iter);
+
+    /**
+     * @return the position past the last one for_each_range takes */
+    size_t (*range_end)(hashmap_t * hmap);
+
+    /**
+     * Call fn on the entries at positions begin up to end, in the order
+     * an iterator would reach them. */
+    void (*for_each_range)(
+        hashmap_t * hmap,
+        size_t begin,
+        size_t end,
+        hashmap_for_each_f fn,
+        void *ctx);
+
+    /**
+     * Fill in chains, max_chain, chained_nodes and the bytes held by the
+     * array. Everything else has been zeroed. */
+    void (*stats)(hashmap_t * hmap, hashmap_stats_t * stats);
+
+    /* grow_load a new map starts with */
+    double default_load;
+
+    /* fewest buckets alloc will go down to */
+    size_t min_size;
+
+    /* whether full buckets chain further entries off them, so that
+     * grow_load can be 1 or more */
+    int chains;
+};
+
+typedef struct node_s node_t;
+
+/* a bucket of the chained backend's array, or a node on its chain */
+struct node_s
+{
+    hashmap_entry_t ety;
+    /* the key's full hash, so that we never need to hash it again */
+    unsigned long hash;
+    node_t *next;
+};
+
+typedef struct slab_s slab_t;
+
+/* Chain nodes are carved out of slabs, in list order. Slabs are only given
+ * back when the map is freed; released nodes go onto a free list to be
+ * reused, and clearing starts carving from the first slab again. */
+struct slab_s
+{
+    slab_t *next;
+    size_t size;
+    node_t nodes[];
+};
+
+/* grow_load a chained map starts with */
+#define HASHMAP_CHAINED_LOAD 0.5
+
+extern const hashmap_backend_t hashmap_backend_open_addressing;
+extern const hashmap_backend_t hashmap_backend_ordered;
+extern const hashmap_backend_t hashmap_backend_inline_buckets;
+
+/**
+ * Fold a hash's high bits down into its low bits, for when only the low
+ * bits pick a bucket. Each step is invertible so no two hashes become
+ * equal. */
+static inline unsigned long __mix_hash(unsigned long hash)
+{
+#if ULONG_MAX > 0xffffffffUL
+    uint64_t h = hash;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+#else
+    /* MurmurHash3's 32 bit finaliser, for where long is 32 bits */
+    uint32_t h = hash;
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h;
+#endif
+}
+
+/**
+ * @return smallest power of two that is at least n, or the largest there
+ *         is if n is bigger than that */
+static inline size_t __roundup_pow2(size_t n)
+{
+    size_t p = 1;
+
+    while (p < n && p <= SIZE_MAX / 2)
+        p <<= 1;
+    return p;
+}
+
+/**
+ * @return array size after growing by this factor */
+static inline size_t __grown_size(hashmap_t * h, unsigned int factor)
+{
+    size_t size = h->arraySize * factor;
+
+    if (h->flags & HASHMAP_POW2)
+        size = __roundup_pow2(size);
+    return size;
+}
+
+/**
+ * Resize through the backend, keeping count of resizes and their time. */
+void hashmap_resize(hashmap_t * h, size_t size);
+
+/**
+ * hashmap_get, hashmap_put and hashmap_remove for a caller that has
+ * already hashed the key, mixed as for HASHMAP_POW2 if the map uses it.
+ * Keys and vals must not be NULL. */
+void *hashmap_get_hashed(hashmap_t * h, unsigned long hash, const void *key);
+
+void *hashmap_put_hashed(
+    hashmap_t * h,
+    unsigned long hash,
+    void *key,
+    void *val
+);
+
+void *hashmap_remove_hashed(
+    hashmap_t * h,
+    unsigned long hash,
+    const void *key
+);
+
+/**
+ * Count a get that looked at this many buckets, nodes, groups or slots.
+ * Gets can run on many threads at once, so the counters are atomic.
+ * Compiled out unless HASHMAP_STATS is defined. */
+static inline void __stat_lookup(hashmap_t * h, size_t probes, int found)
+{
+#ifdef HASHMAP_STATS
+    __atomic_fetch_add(&h->stat_lookups, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->stat_lookup_probes, probes, __ATOMIC_RELAXED);
+    if (!found)
+    {
+        __atomic_fetch_add(&h->stat_misses, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&h->stat_miss_probes, probes, __ATOMIC_RELAXED);
+    }
+#else
+    (void)h;
+    (void)probes;
+    (void)found;
+#endif
+}
+
+/**
+ * Add a chain of this length to the stats. */
+static inline void __stat_chain(hashmap_stats_t * stats, size_t len)
+{
+    stats->chains[len < HASHMAP_STATS_CHAINS ? len : HASHMAP_STATS_CHAINS - 1]++;
+    if (stats->max_chain < len)
+        stats->max_chain = len;
+}
+
+#endif /* LINKED_LIST_HASHMAP_PRIVATE_H */
@@ -0,0 +1,445 @@
+/*
+
+   Copyright (c) 2011, Willem-Hendrik Thiart
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+ * The names of its contributors may not be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL WILLEM-HENDRIK THIART BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+/*
+ * Open addressing backend, Swiss table style.
+ *
+ * The array is one control byte per slot followed by the slots. A full
+ * slot's control byte has its top bit set and holds 7 bits of the hash, so
+ * a group of 16 control bytes can be checked for a key in a couple of
+ * SSE2 instructions before we look at any slot.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <sys/types.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "linked_list_hashmap.h"
+#include "linked_list_hashmap_private.h"
+
+#define GROUP_SIZE 16
+
+#define CTRL_EMPTY 0x00
+#define CTRL_DELETED 0x01
+#define CTRL_FULL 0x80
+
+typedef struct
+{
+    hashmap_entry_t ety;
+    /* the key's full hash, so that we never need to hash it again */
+    unsigned long hash;
+} slot_t;
+
+inline static uint8_t *__ctrl(hashmap_t * h)
+{
+    return h->array;
+}
+
+inline static slot_t *__slots(hashmap_t * h)
+{
+    return (slot_t*)((uint8_t*)h->array + h->arraySize);
+}
+
+/**
+ * @return control byte for a full slot with this hash */
+inline static uint8_t __h2(unsigned long hash)
+{
+    return CTRL_FULL | (hash & 0x7f);
+}
+
+#ifdef __SSE2__
+
+/**
+ * @return bitmask of the control bytes in this group that equal c */
+inline static unsigned int __match(const uint8_t *group, uint8_t c)
+{
+    __m128i g = _mm_loadu_si128((const __m128i*)group);
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)c)));
+}
+
+/**
+ * @return bitmask of the full slots in this group */
+inline static unsigned int __match_full(const uint8_t *group)
+{
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+}
+
+#else
+
+inline static unsigned int __match(const uint8_t *group, uint8_t c)
+{
+    unsigned int i, mask = 0;
+
+    for (i = 0; i < GROUP_SIZE; i++)
+        if (group[i] == c)
+            mask |= 1 << i;
+    return mask;
+}
+
+inline static unsigned int __match_full(const uint8_t *group)
+{
+    unsigned int i, mask = 0;
+
+    for (i = 0; i < GROUP_SIZE; i++)
+        if (group[i] & CTRL_FULL)
+            mask |= 1 << i;
+    return mask;
+}
+
+#endif
+
+/**
+ * Groups are visited in triangular steps, which reaches every group when
+ * there is a power of two of them. */
+typedef struct
+{
+    size_t group;
+    size_t step;
+    size_t mask;
+} probe_t;
+
+inline static void __probe_start(hashmap_t * h, probe_t * p, unsigned long hash)
+{
+    p->mask = h->arraySize / GROUP_SIZE - 1;
+    /* the low 7 bits went into the control byte */
+    p->group = (hash >> 7) & p->mask;
+    p->step = 0;
+}
+
+inline static void __probe_next(probe_t * p)
+{
+    p->step++;
+    p->group = (p->group + p->step) & p->mask;
+}
+
+/**
+ * @param probes : incremented for each group looked at
+ * @return index of the slot holding this key, otherwise -1 */
+static ssize_t __find(
+    hashmap_t * h,
+    unsigned long hash,
+    const void *key,
+    size_t *probes
+    )
+{
+    uint8_t *ctrl = __ctrl(h);
+    slot_t *slots = __slots(h);
+    uint8_t h2 = __h2(hash);
+    probe_t p;
+
+    __probe_start(h, &p, hash);
+    do
+    {
+        uint8_t *group = &ctrl[p.group * GROUP_SIZE];
+        unsigned int m = __match(group, h2);
+
+        (*probes)++;
+
+        while (m)
+        {
+            size_t i = p.group * GROUP_SIZE + __builtin_ctz(m);
+
+            if (slots[i].hash == hash && 0 == h->compare(key, slots[i].ety.key))
+                return i;
+            m &= m - 1;
+        }
+
+        /* the key would have gone into an empty slot here */
+        if (__match(group, CTRL_EMPTY))
+            return -1;
+
+        __probe_next(&p);
+    }
+    while (p.step <= p.mask);
+
+    return -1;
+}
+
+/**
+ * @return index of the first slot a new entry with this hash can go in */
+static size_t __find_free(hashmap_t * h, unsigned long hash)
+{
+    uint8_t *ctrl = __ctrl(h);
+    probe_t p;
+
+    __probe_start(h, &p, hash);
+    for (;;)
+    {
+        unsigned int m = ~__match_full(&ctrl[p.group * GROUP_SIZE]) & 0xffff;
+
+        if (m)
+            return p.group * GROUP_SIZE + __builtin_ctz(m);
+
+        /* ensurecapacity means there is always a free slot */
+        assert(p.step <= p.mask);
+        __probe_next(&p);
+    }
+}
+
+static void __oa_alloc(hashmap_t * h)
+{
+    if (h->arraySize < GROUP_SIZE)
+        h->arraySize = GROUP_SIZE;
+    /* zeroed control bytes are all CTRL_EMPTY */
+    h->array = calloc(1, h->arraySize * (1 + sizeof(slot_t)));
+}
+
+static void __oa_free(hashmap_t * h)
+{
+    free(h->array);
+}
+
+static void __oa_clear(hashmap_t * h)
+{
+    memset(__ctrl(h), CTRL_EMPTY, h->arraySize);
+    h->count = 0;
+    h->tombstones = 0;
+}
+
+static hashmap_entry_t *__oa_get(
+    hashmap_t * h,
+    unsigned long hash,
+    const void *key
+    )
+{
+    size_t probes = 0;
+    ssize_t i = __find(h, hash, key, &probes);
+
+    __stat_lookup(h, probes, -1 != i);
+    return -1 == i ? NULL : &__slots(h)[i].ety;
+}
+
+static void *__oa_put(
+    hashmap_t * h,
+    unsigned long hash,
+    void *key,
+    void *val
+    )
+{
+    size_t probes = 0;
+    ssize_t i = __find(h, hash, key, &probes);
+    slot_t *slot;
+
+    /* if same key, then we are just replacing val */
+    if (-1 != i)
+    {
+        void *val_prev = __slots(h)[i].ety.val;
+        __slots(h)[i].ety.val = val;
+        return val_prev;
+    }
+
+    i = __find_free(h, hash);
+    if (CTRL_DELETED == __ctrl(h)[i])
+        h->tombstones--;
+    __ctrl(h)[i] = __h2(hash);
+    slot = &__slots(h)[i];
+    slot->ety.key = key;
+    slot->ety.val = val;
+    slot->hash = hash;
+    h->count++;
+    return NULL;
+}
+
+static int __oa_remove(
+    hashmap_t * h,
+    unsigned long hash,
+    const void *key,
+    hashmap_entry_t * entry
+    )
+{
+    size_t probes = 0;
+    ssize_t i = __find(h, hash, key, &probes);
+    uint8_t *group;
+
+    if (-1 == i)
+        return 0;
+
+    memcpy(entry, &__slots(h)[i].ety, sizeof(hashmap_entry_t));
+
+    /* Lookups stop at a group with an empty slot. If this group already
+     * has one, no lookup goes past it and the slot can simply be empty.
+     * Otherwise it has to stay a tombstone. */
+    group = &__ctrl(h)[i / GROUP_SIZE * GROUP_SIZE];
+    if (__match(group, CTRL_EMPTY))
+        __ctrl(h)[i] = CTRL_EMPTY;
+    else
+    {
+        __ctrl(h)[i] = CTRL_DELETED;
+        h->tombstones++;
+    }
+
+    h->count--;
+    return 1;
+}
+
+static void __oa_resize(hashmap_t * h, size_t size)
+{
+    void *array_old = h->array;
+    uint8_t *ctrl_old = __ctrl(h);
+    slot_t *slots_old = __slots(h);
+    size_t i, size_old = h->arraySize;
+
+    h->arraySize = size;
+    __oa_alloc(h);
+    h->tombstones = 0;
+
+    for (i = 0; i < size_old; i++)
+    {
+        size_t j;
+
+        if (!(ctrl_old[i] & CTRL_FULL))
+            continue;
+
+        /* keys are unique, so we only need a free slot */
+        j = __find_free(h, slots_old[i].hash);
+        __ctrl(h)[j] = ctrl_old[i];
+        __slots(h)[j] = slots_old[i];
+    }
+
+    free(array_old);
+}
+
+static void __oa_prefetch(hashmap_t * h, unsigned long hash)
+{
+    probe_t p;
+
+    __probe_start(h, &p, hash);
+    __builtin_prefetch(&__ctrl(h)[p.group * GROUP_SIZE]);
+    __builtin_prefetch(&__slots(h)[p.group * GROUP_SIZE]);
+}
+
+static void __oa_ensurecapacity(hashmap_t * h)
+{
+    /* full and deleted slots both count towards the load */
+    if ((double)(h->count + h->tombstones + 1) / h->arraySize < h->grow_load)
+        return;
+
+    /* if it's mostly tombstones, sweeping them out is enough */
+    if ((double)(h->count + 1) / h->arraySize < h->grow_load / 2)
+        hashmap_resize(h, h->arraySize);
+    else
+        hashmap_resize(h, __grown_size(h, h->grow_factor));
+}
+
+static hashmap_entry_t *__oa_iterator_peek(
+    hashmap_t * h,
+    hashmap_iterator_t * iter
+    )
+{
+    for (; iter->cur < h->arraySize; iter->cur++)
+        if (__ctrl(h)[iter->cur] & CTRL_FULL)
+            return &__slots(h)[iter->cur].ety;
+    return NULL;
+}
+
+static hashmap_entry_t *__oa_iterator_next(
+    hashmap_t * h,
+    hashmap_iterator_t * iter
+    )
+{
+    hashmap_entry_t *ety = __oa_iterator_peek(h, iter);
+
+    /* entries never move when removing, so it's safe to step past */
+    if (ety)
+        iter->cur++;
+    return ety;
+}
+
+static size_t __oa_range_end(hashmap_t * h)
+{
+    return h->arraySize;
+}
+
+static void __oa_for_each_range(
+    hashmap_t * h,
+    size_t begin,
+    size_t end,
+    hashmap_for_each_f fn,
+    void *ctx
+    )
+{
+    uint8_t *ctrl = __ctrl(h);
+    slot_t *slots = __slots(h);
+    size_t i;
+
+    for (i = begin; i < end; i++)
+        if (ctrl[i] & CTRL_FULL)
+            fn(&slots[i].ety, ctx);
+}
+
+static void __oa_stats(hashmap_t * h, hashmap_stats_t * stats)
+{
+    size_t i;
+
+    for (i = 0; i < h->arraySize; i++)
+    {
+        size_t len = 1;
+        probe_t p;
+
+        if (!(__ctrl(h)[i] & CTRL_FULL))
+            continue;
+
+        /* retrace the lookup to find how many groups it visits */
+        __probe_start(h, &p, __slots(h)[i].hash);
+        for (; p.group != i / GROUP_SIZE; len++)
+            __probe_next(&p);
+
+        __stat_chain(stats, len);
+        if (1 < len)
+            stats->chained_nodes++;
+    }
+    stats->bytes = h->arraySize * (1 + sizeof(slot_t));
+}
+
+const hashmap_backend_t hashmap_backend_open_addressing = {
+    .alloc = __oa_alloc,
+    .free = __oa_free,
+    .clear = __oa_clear,
+    .get = __oa_get,
+    .put = __oa_put,
+    .remove = __oa_remove,
+    .prefetch = __oa_prefetch,
+    .ensurecapacity = __oa_ensurecapacity,
+    .resize = __oa_resize,
+    .iterator_peek = __oa_iterator_peek,
+    .iterator_next = __oa_iterator_next,
+    .range_end = __oa_range_end,
+    .for_each_range = __oa_for_each_range,
+    .stats = __oa_stats,
+    .default_load = 0.875,
+    .min_size = GROUP_SIZE,
+};
+
+/*--------------------------------------------------------------79-characters-*/
@@ -0,0 +1,370 @@
+/*
+
+   Copyright (c) 2011, Willem-Hendrik Thiart
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+ * The names of its contributors may not be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL WILLEM-HENDRIK THIART BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+/*
+ * Insertion ordered backend, in the style of Python's compact dict.
+ *
+ * Entries are appended to a dense array in the order they were put, and
+ * the hash table only holds 32 bit indices into it, found by linear
+ * probing. Iterating is a straight sweep over the dense array. Removing
+ * leaves a hole in the dense array that the next resize squeezes out.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "linked_list_hashmap.h"
+#include "linked_list_hashmap_private.h"
+
+/* index slot values; anything else is an entry's position plus IDX_FIRST */
+#define IDX_EMPTY 0
+#define IDX_DELETED 1
+#define IDX_FIRST 2
+
+typedef struct
+{
+    hashmap_entry_t ety;
+    /* the key's full hash, so that we never need to hash it again */
+    unsigned long hash;
+} dense_t;
+
+typedef struct
+{
+    /* in insertion order; removed entries have a NULL key */
+    dense_t *entries;
+    /* entries used, including removed ones */
+    size_t nentries;
+    /* entries there is room for */
+    size_t capacity;
+    uint32_t indices[];
+} ordered_t;
+
+inline static ordered_t *__ordered(hashmap_t * h)
+{
+    return h->array;
+}
+
+/**
+ * @return how many entries fit in this many index slots before we have to
+ * resize. The default load keeps a third of the slots empty, which keeps
+ * probes short. */
+inline static size_t __usable(hashmap_t * h, size_t size)
+{
+    return size * h->grow_load;
+}
+
+/**
+ * @param probes : incremented for each index slot looked at
+ * @return index slot holding this key, otherwise -1 */
+static ssize_t __find(
+    hashmap_t * h,
+    unsigned long hash,
+    const void *key,
+    size_t *probes
+    )
+{
+    ordered_t *o = __ordered(h);
+    size_t mask = h->arraySize - 1, i;
+
+    for (i = hash & mask;; i = (i + 1) & mask)
+    {
+        uint32_t idx = o->indices[i];
+        dense_t *e;
+
+        (*probes)++;
+        if (IDX_EMPTY == idx)
+            return -1;
+        if (IDX_DELETED == idx)
+            continue;
+
+        e = &o->entries[idx - IDX_FIRST];
+        if (e->hash == hash && 0 == h->compare(key, e->ety.key))
+            return i;
+    }
+}
+
+/**
+ * @return index slot a new entry with this hash can go in */
+static size_t __find_free(hashmap_t * h, unsigned long hash)
+{
+    ordered_t *o = __ordered(h);
+    size_t mask = h->arraySize - 1, i;
+
+    /* at most __usable() slots are ever taken, so this finds one */
+    for (i = hash & mask; IDX_DELETED < o->indices[i]; i = (i + 1) & mask)
+        ;
+    return i;
+}
+
+static void __ord_alloc(hashmap_t * h)
+{
+    ordered_t *o;
+
+    if (h->arraySize < 8)
+        h->arraySize = 8;
+
+    /* zeroed indices are all IDX_EMPTY */
+    o = calloc(1, sizeof(ordered_t) + h->arraySize * sizeof(uint32_t));
+    o->capacity = __usable(h, h->arraySize);
+    assert(o->capacity < h->arraySize);
+    assert(o->capacity <= UINT32_MAX - IDX_FIRST);
+    o->entries = malloc(o->capacity * sizeof(dense_t));
+    h->array = o;
+}
+
+static void __ord_free(hashmap_t * h)
+{
+    free(__ordered(h)->entries);
+    free(h->array);
+}
+
+static void __ord_clear(hashmap_t * h)
+{
+    ordered_t *o = __ordered(h);
+
+    memset(o->indices, IDX_EMPTY, h->arraySize * sizeof(uint32_t));
+    o->nentries = 0;
+    h->count = 0;
+    h->tombstones = 0;
+}
+
+static hashmap_entry_t *__ord_get(
+    hashmap_t * h,
+    unsigned long hash,
+    const void *key
+    )
+{
+    ordered_t *o = __ordered(h);
+    size_t probes = 0;
+    ssize_t i = __find(h, hash, key, &probes);
+
+    __stat_lookup(h, probes, -1 != i);
+    return -1 == i ? NULL : &o->entries[o->indices[i] - IDX_FIRST].ety;
+}
+
+static void *__ord_put(
+    hashmap_t * h,
+    unsigned long hash,
+    void *key,
+    void *val
+    )
+{
+    ordered_t *o = __ordered(h);
+    size_t probes = 0;
+    ssize_t i = __find(h, hash, key, &probes);
+    dense_t *e;
+
+    /* if same key, then we are just replacing val */
+    if (-1 != i)
+    {
+        void *val_prev;
+
+        e = &o->entries[o->indices[i] - IDX_FIRST];
+        val_prev = e->ety.val;
+        e->ety.val = val;
+        return val_prev;
+    }
+
+    assert(o->nentries < o->capacity);
+    e = &o->entries[o->nentries];
+    e->ety.key = key;
+    e->ety.val = val;
+    e->hash = hash;
+    o->indices[__find_free(h, hash)] = o->nentries++ + IDX_FIRST;
+    h->count++;
+    return NULL;
+}
+
+static int __ord_remove(
+    hashmap_t * h,
+    unsigned long hash,
+    const void *key,
+    hashmap_entry_t * entry
+    )
+{
+    ordered_t *o = __ordered(h);
+    size_t probes = 0;
+    ssize_t i = __find(h, hash, key, &probes);
+    dense_t *e;
+
+    if (-1 == i)
+        return 0;
+
+    e = &o->entries[o->indices[i] - IDX_FIRST];
+    memcpy(entry, &e->ety, sizeof(hashmap_entry_t));
+
+    /* entries don't move, so iterators are unaffected */
+    e->ety.key = NULL;
+    o->indices[i] = IDX_DELETED;
+    h->tombstones++;
+    h->count--;
+    return 1;
+}
+
+static void __ord_resize(hashmap_t * h, size_t size)
+{
+    ordered_t *o_old = __ordered(h);
+    size_t i;
+
+    while (__usable(h, size) < h->count + 1)
+        size *= 2;
+
+    h->arraySize = size;
+    __ord_alloc(h);
+
+    /* squeeze out the holes, keeping the order */
+    for (i = 0; i < o_old->nentries; i++)
+    {
+        ordered_t *o = __ordered(h);
+
+        if (!o_old->entries[i].ety.key)
+            continue;
+
+        o->entries[o->nentries] = o_old->entries[i];
+        o->indices[__find_free(h, o_old->entries[i].hash)] =
+            o->nentries++ + IDX_FIRST;
+    }
+    h->tombstones = 0;
+
+    free(o_old->entries);
+    free(o_old);
+}
+
+static void __ord_prefetch(hashmap_t * h, unsigned long hash)
+{
+    __builtin_prefetch(&__ordered(h)->indices[hash & (h->arraySize - 1)]);
+}
+
+static void __ord_ensurecapacity(hashmap_t * h)
+{
+    ordered_t *o = __ordered(h);
+
+    if (o->nentries < o->capacity)
+        return;
+
+    /* if it's mostly holes, squeezing them out is enough */
+    if (h->count + 1 <= o->capacity / 2)
+        hashmap_resize(h, h->arraySize);
+    else
+        hashmap_resize(h, __grown_size(h, h->grow_factor));
+}
+
+static hashmap_entry_t *__ord_iterator_peek(
+    hashmap_t * h,
+    hashmap_iterator_t * iter
+    )
+{
+    ordered_t *o = __ordered(h);
+
+    for (; iter->cur < o->nentries; iter->cur++)
+        if (o->entries[iter->cur].ety.key)
+            return &o->entries[iter->cur].ety;
+    return NULL;
+}
+
+static hashmap_entry_t *__ord_iterator_next(
+    hashmap_t * h,
+    hashmap_iterator_t * iter
+    )
+{
+    hashmap_entry_t *ety = __ord_iterator_peek(h, iter);
+
+    if (ety)
+        iter->cur++;
+    return ety;
+}
+
+static size_t __ord_range_end(hashmap_t * h)
+{
+    return __ordered(h)->nentries;
+}
+
+static void __ord_for_each_range(
+    hashmap_t * h,
+    size_t begin,
+    size_t end,
+    hashmap_for_each_f fn,
+    void *ctx
+    )
+{
+    dense_t *entries = __ordered(h)->entries;
+    size_t i;
+
+    /* removed entries are left behind as holes with a NULL key */
+    for (i = begin; i < end; i++)
+        if (entries[i].ety.key)
+            fn(&entries[i].ety, ctx);
+}
+
+static void __ord_stats(hashmap_t * h, hashmap_stats_t * stats)
+{
+    ordered_t *o = __ordered(h);
+    size_t mask = h->arraySize - 1, i;
+
+    for (i = 0; i < h->arraySize; i++)
+    {
+        size_t len;
+
+        if (o->indices[i] < IDX_FIRST)
+            continue;
+
+        /* linear probing, so it's how far the slot is from home */
+        len = ((i - (o->entries[o->indices[i] - IDX_FIRST].hash & mask)) &
+               mask) + 1;
+        __stat_chain(stats, len);
+        if (1 < len)
+            stats->chained_nodes++;
+    }
+    stats->bytes = sizeof(ordered_t) + h->arraySize * sizeof(uint32_t) +
+        o->capacity * sizeof(dense_t);
+}
+
+const hashmap_backend_t hashmap_backend_ordered = {
+    .alloc = __ord_alloc,
+    .free = __ord_free,
+    .clear = __ord_clear,
+    .get = __ord_get,
+    .put = __ord_put,
+    .remove = __ord_remove,
+    .prefetch = __ord_prefetch,
+    .ensurecapacity = __ord_ensurecapacity,
+    .resize = __ord_resize,
+    .iterator_peek = __ord_iterator_peek,
+    .iterator_next = __ord_iterator_next,
+    .range_end = __ord_range_end,
+    .for_each_range = __ord_for_each_range,
+    .stats = __ord_stats,
+    .default_load = 2.0 / 3,
+    .min_size = 8,
+};
+
+/*--------------------------------------------------------------79-characters-*/
@@ -0,0 +1,281 @@
+/*
+
+   Copyright (c) 2011, Willem-Hendrik Thiart
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+ * The names of its contributors may not be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL WILLEM-HENDRIK THIART BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "linked_list_hashmap.h"
+#include "linked_list_hashmap_private.h"
+#include "sharded_hashmap.h"
+
+/* a shard to a cache line, so that threads on different shards don't
+ * contend on lines */
+typedef struct
+{
+    hashmap_t *hm;
+    pthread_mutex_t lock;
+} __attribute__((aligned(64))) shard_t;
+
+inline static shard_t *__shard(sharded_hashmap_t * h, size_t idx)
+{
+    return &((shard_t*)h->shards)[idx];
+}
+
+/**
+ * Hash a key once, for both picking its shard and finding it in there.
+ * Shards are HASHMAP_POW2, so they use the low bits of this same mixed
+ * hash for their buckets. */
+inline static unsigned long __hash(sharded_hashmap_t * h, const void *key)
+{
+    return __mix_hash(h->hash(key));
+}
+
+inline static size_t __shard_idx(sharded_hashmap_t * h, unsigned long hash)
+{
+    return 1 == h->nshards ? 0 : hash >> h->shift;
+}
+
+inline static void __lock(sharded_hashmap_t * h, shard_t * s)
+{
+    if (h->flags & SHARDED_HASHMAP_LOCKED)
+        pthread_mutex_lock(&s->lock);
+}
+
+inline static void __unlock(sharded_hashmap_t * h, shard_t * s)
+{
+    if (h->flags & SHARDED_HASHMAP_LOCKED)
+        pthread_mutex_unlock(&s->lock);
+}
+
+sharded_hashmap_t *sharded_hashmap_new(
+    func_longhash_f hash,
+    func_longcmp_f cmp,
+    size_t initial_capacity,
+    size_t nshards,
+    int flags
+    )
+{
+    sharded_hashmap_t *h = calloc(1, sizeof(sharded_hashmap_t));
+    unsigned int bits = 0;
+    size_t i;
+
+    h->hash = hash;
+    h->flags = flags;
+    h->nshards = __roundup_pow2(nshards);
+    while ((1UL << bits) < h->nshards)
+        bits++;
+    h->shift = sizeof(unsigned long) * 8 - bits;
+    if (0 != posix_memalign(&h->shards, sizeof(shard_t),
+                            h->nshards * sizeof(shard_t)))
+    {
+        free(h);
+        return NULL;
+    }
+
+    for (i = 0; i < h->nshards; i++)
+    {
+        shard_t *s = __shard(h, i);
+
+        s->hm = hashmap_new_with_flags(hash, cmp, initial_capacity,
+                                       HASHMAP_POW2);
+        pthread_mutex_init(&s->lock, NULL);
+    }
+    return h;
+}
+
+void sharded_hashmap_freeall(sharded_hashmap_t * h)
+{
+    size_t i;
+
+    for (i = 0; i < h->nshards; i++)
+    {
+        hashmap_freeall(__shard(h, i)->hm);
+        pthread_mutex_destroy(&__shard(h, i)->lock);
+    }
+    free(h->shards);
+    free(h);
+}
+
+size_t sharded_hashmap_shard_of(sharded_hashmap_t * h, const void *key)
+{
+    return __shard_idx(h, __hash(h, key));
+}
+
+size_t sharded_hashmap_count(sharded_hashmap_t * h)
+{
+    size_t i, count = 0;
+
+    for (i = 0; i < h->nshards; i++)
+    {
+        shard_t *s = __shard(h, i);
+
+        __lock(h, s);
+        count += hashmap_count(s->hm);
+        __unlock(h, s);
+    }
+    return count;
+}
+
+void sharded_hashmap_shard_stats(
+    sharded_hashmap_t * h,
+    size_t shard,
+    sharded_hashmap_stats_t * stats
+    )
+{
+    shard_t *s = __shard(h, shard);
+    hashmap_node_pool_stats_t pool;
+
+    assert(shard < h->nshards);
+
+    __lock(h, s);
+    stats->count = hashmap_count(s->hm);
+    stats->size = hashmap_size(s->hm);
+    hashmap_node_pool_stats(s->hm, &pool);
+    stats->pool_bytes = pool.bytes;
+    __unlock(h, s);
+}
+
+void *sharded_hashmap_get(
+    sharded_hashmap_t * h,
+    const void *key
+    )
+{
+    unsigned long hash;
+    shard_t *s;
+    void *val;
+
+    if (!key)
+        return NULL;
+
+    hash = __hash(h, key);
+    s = __shard(h, __shard_idx(h, hash));
+    __lock(h, s);
+    val = hashmap_get_hashed(s->hm, hash, key);
+    __unlock(h, s);
+    return val;
+}
+
+int sharded_hashmap_contains_key(
+    sharded_hashmap_t * h,
+    const void *key
+    )
+{
+    return NULL != sharded_hashmap_get(h, key);
+}
+
+void *sharded_hashmap_put(
+    sharded_hashmap_t * h,
+    void *key,
+    void *val
+    )
+{
+    unsigned long hash;
+    shard_t *s;
+    void *val_prev;
+
+    if (!key || !val)
+        return NULL;
+
+    hash = __hash(h, key);
+    s = __shard(h, __shard_idx(h, hash));
+    __lock(h, s);
+    val_prev = hashmap_put_hashed(s->hm, hash, key, val);
+    __unlock(h, s);
+    return val_prev;
+}
+
+void *sharded_hashmap_remove(
+    sharded_hashmap_t * h,
+    const void *key
+    )
+{
+    unsigned long hash;
+    shard_t *s;
+    void *val;
+
+    if (!key)
+        return NULL;
+
+    hash = __hash(h, key);
+    s = __shard(h, __shard_idx(h, hash));
+    __lock(h, s);
+    val = hashmap_remove_hashed(s->hm, hash, key);
+    __unlock(h, s);
+    return val;
+}
+
+void sharded_hashmap_iterator(
+    sharded_hashmap_t * h,
+    sharded_hashmap_iterator_t * iter
+    )
+{
+    iter->shard = 0;
+    hashmap_iterator(__shard(h, 0)->hm, &iter->iter);
+}
+
+int sharded_hashmap_iterator_has_next(
+    sharded_hashmap_t * h,
+    sharded_hashmap_iterator_t * iter
+    )
+{
+    /* move on past shards that have nothing left */
+    while (!hashmap_iterator_has_next(__shard(h, iter->shard)->hm,
+                                      &iter->iter))
+    {
+        if (h->nshards <= iter->shard + 1)
+            return 0;
+        iter->shard++;
+        hashmap_iterator(__shard(h, iter->shard)->hm, &iter->iter);
+    }
+    return 1;
+}
+
+void *sharded_hashmap_iterator_next(
+    sharded_hashmap_t * h,
+    sharded_hashmap_iterator_t * iter
+    )
+{
+    if (!sharded_hashmap_iterator_has_next(h, iter))
+        return NULL;
+    return hashmap_iterator_next(__shard(h, iter->shard)->hm, &iter->iter);
+}
+
+void *sharded_hashmap_iterator_next_value(
+    sharded_hashmap_t * h,
+    sharded_hashmap_iterator_t * iter
+    )
+{
+    if (!sharded_hashmap_iterator_has_next(h, iter))
+        return NULL;
+    return hashmap_iterator_next_value(__shard(h, iter->shard)->hm,
+                                       &iter->iter);
+}
+
+/*--------------------------------------------------------------79-characters-*/
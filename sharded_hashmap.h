@@ -0,0 +1,147 @@
+#ifndef SHARDED_HASHMAP_H
+#define SHARDED_HASHMAP_H
+
+#include "linked_list_hashmap.h"
+
+/**
+ * A map split into independent hashmap_t shards.
+ *
+ * A key's shard comes from the high bits of its mixed hash, while each
+ * shard indexes its buckets with the low bits, so the two don't skew each
+ * other. Every shard grows on its own, so a resize only stalls the keys of
+ * one shard. A thread-per-core server can give each thread a shard of its
+ * own through sharded_hashmap_shard_of(). */
+typedef struct
+{
+    void *shards;
+    size_t nshards;
+    /* shift that leaves a hash's shard bits */
+    unsigned int shift;
+    func_longhash_f hash;
+    int flags;
+} sharded_hashmap_t;
+
+enum {
+    /* each shard gets a mutex that every call on it holds. Iterators
+     * don't take the locks. */
+    SHARDED_HASHMAP_LOCKED = 1 << 0,
+};
+
+typedef struct
+{
+    size_t count;
+    /* buckets in the shard's array */
+    size_t size;
+    /* memory held by the shard's chain node reservoir */
+    size_t pool_bytes;
+} sharded_hashmap_stats_t;
+
+typedef struct
+{
+    size_t shard;
+    hashmap_iterator_t iter;
+} sharded_hashmap_iterator_t;
+
+/**
+ * @param initial_capacity : capacity of each shard
+ * @param nshards : rounded up to a power of two
+ * @param flags : SHARDED_HASHMAP_* flags */
+sharded_hashmap_t *sharded_hashmap_new(
+    func_longhash_f hash,
+    func_longcmp_f cmp,
+    size_t initial_capacity,
+    size_t nshards,
+    int flags
+);
+
+/**
+ * Free all the memory related to this hash.
+ * This includes the actual h itself. */
+void sharded_hashmap_freeall(
+    sharded_hashmap_t * hmap
+);
+
+/**
+ * @return which shard this key lives in */
+size_t sharded_hashmap_shard_of(
+    sharded_hashmap_t * hmap,
+    const void *key
+);
+
+/**
+ * @return number of items within all shards */
+size_t sharded_hashmap_count(
+    sharded_hashmap_t * hmap
+);
+
+/**
+ * Report how big one shard is. */
+void sharded_hashmap_shard_stats(
+    sharded_hashmap_t * hmap,
+    size_t shard,
+    sharded_hashmap_stats_t * stats
+);
+
+/**
+ * Get this key's value.
+ * @return key's item, otherwise NULL */
+void *sharded_hashmap_get(
+    sharded_hashmap_t * hmap,
+    const void *key
+);
+
+/**
+ * Is this key inside this map?
+ * @return 1 if key is in hash, otherwise 0 */
+int sharded_hashmap_contains_key(
+    sharded_hashmap_t * hmap,
+    const void *key
+);
+
+/**
+ * Associate key with val.
+ * @return previous associated val; otherwise NULL */
+void *sharded_hashmap_put(
+    sharded_hashmap_t * hmap,
+    void *key,
+    void *val
+);
+
+/**
+ * Remove this key and value from the map.
+ * @return value of key, or NULL on failure */
+void *sharded_hashmap_remove(
+    sharded_hashmap_t * hmap,
+    const void *key
+);
+
+/**
+ * Initialise a new iterator over every shard in turn.
+ * It is safe to remove items while iterating. */
+void sharded_hashmap_iterator(
+    sharded_hashmap_t * hmap,
+    sharded_hashmap_iterator_t * iter
+);
+
+int sharded_hashmap_iterator_has_next(
+    sharded_hashmap_t * hmap,
+    sharded_hashmap_iterator_t * iter
+);
+
+/**
+ * Iterate to the next item on a hash iterator
+ * @return next item key from iterator */
+void *sharded_hashmap_iterator_next(
+    sharded_hashmap_t * hmap,
+    sharded_hashmap_iterator_t * iter
+);
+
+/**
+ * Iterate to the next item on a hash iterator
+ * @return next item value from iterator */
+void *sharded_hashmap_iterator_next_value(
+    sharded_hashmap_t * hmap,
+    sharded_hashmap_iterator_t * iter
+);
+
+#endif /* SHARDED_HASHMAP_H */
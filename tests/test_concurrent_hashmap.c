@@ -0,0 +1,230 @@
+#include <stdbool.h>
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "CuTest.h"
+
+#include "concurrent_hashmap.h"
+
+#define NTHREADS 4
+#define PER_THREAD 20000
+
+static unsigned long __uint_hash(
+    const void *e1
+    )
+{
+    const long i1 = (unsigned long)e1;
+
+    assert(i1 >= 0);
+    return i1;
+}
+
+static long __uint_compare(
+    const void *e1,
+    const void *e2
+    )
+{
+    const long i1 = (unsigned long)e1, i2 = (unsigned long)e2;
+
+    return i1 - i2;
+}
+
+void TestConcurrentHashmap_PutGetRemove(
+    CuTest * tc
+    )
+{
+    concurrent_hashmap_t *hm;
+
+    hm = concurrent_hashmap_new(__uint_hash, __uint_compare, 4, 4);
+    CuAssertTrue(tc, NULL == concurrent_hashmap_put(hm, (void*)50, (void*)92));
+    CuAssertTrue(tc, 1 == concurrent_hashmap_count(hm));
+    CuAssertTrue(tc, 92 == (unsigned long)concurrent_hashmap_get(hm, (void*)50));
+    CuAssertTrue(tc, 1 == concurrent_hashmap_contains_key(hm, (void*)50));
+
+    CuAssertTrue(tc, 92 ==
+                 (unsigned long)concurrent_hashmap_put(hm, (void*)50, (void*)23));
+    CuAssertTrue(tc, 1 == concurrent_hashmap_count(hm));
+
+    CuAssertTrue(tc, NULL == concurrent_hashmap_remove(hm, (void*)51));
+    CuAssertTrue(tc, 23 == (unsigned long)concurrent_hashmap_remove(hm, (void*)50));
+    CuAssertTrue(tc, 0 == concurrent_hashmap_count(hm));
+    CuAssertTrue(tc, NULL == concurrent_hashmap_get(hm, (void*)50));
+    concurrent_hashmap_freeall(hm);
+}
+
+static void __sum(void *udata, hashmap_entry_t * entry)
+{
+    *(unsigned long*)udata += (unsigned long)entry->val;
+}
+
+void TestConcurrentHashmap_ForEach(
+    CuTest * tc
+    )
+{
+    concurrent_hashmap_t *hm;
+    unsigned long i, sum = 0;
+
+    hm = concurrent_hashmap_new(__uint_hash, __uint_compare, 4, 2);
+    for (i = 1; i <= 100; i++)
+        concurrent_hashmap_put(hm, (void*)i, (void*)i);
+    concurrent_hashmap_for_each(hm, __sum, &sum);
+    CuAssertTrue(tc, 5050 == sum);
+    concurrent_hashmap_freeall(hm);
+}
+
+typedef struct
+{
+    concurrent_hashmap_t *hm;
+    unsigned long first;
+    int failed;
+} worker_t;
+
+static void *__putter(void *arg)
+{
+    worker_t *w = arg;
+    unsigned long i;
+
+    for (i = w->first; i < w->first + PER_THREAD; i++)
+    {
+        concurrent_hashmap_put(w->hm, (void*)i, (void*)(i + 1));
+        if (i + 1 != (unsigned long)concurrent_hashmap_get(w->hm, (void*)i))
+            w->failed = 1;
+    }
+
+    /* take half of them back out again */
+    for (i = w->first; i < w->first + PER_THREAD; i += 2)
+        if (i + 1 != (unsigned long)concurrent_hashmap_remove(w->hm, (void*)i))
+            w->failed = 1;
+    return NULL;
+}
+
+void TestConcurrentHashmap_ThreadsPuttingWhileResizing(
+    CuTest * tc
+    )
+{
+    concurrent_hashmap_t *hm;
+    pthread_t threads[NTHREADS];
+    worker_t workers[NTHREADS];
+    unsigned long i;
+    int t;
+
+    /* small to start with, so that the threads have to resize */
+    hm = concurrent_hashmap_new(__uint_hash, __uint_compare, 4, 8);
+    for (t = 0; t < NTHREADS; t++)
+    {
+        workers[t].hm = hm;
+        workers[t].first = 1 + t * PER_THREAD;
+        workers[t].failed = 0;
+        pthread_create(&threads[t], NULL, __putter, &workers[t]);
+    }
+    for (t = 0; t < NTHREADS; t++)
+    {
+        pthread_join(threads[t], NULL);
+        CuAssertTrue(tc, 0 == workers[t].failed);
+    }
+
+    CuAssertTrue(tc, NTHREADS * PER_THREAD / 2 == concurrent_hashmap_count(hm));
+    for (i = 1; i <= NTHREADS * PER_THREAD; i++)
+        CuAssertTrue(tc, (i % 2 ? NULL : (void*)(i + 1)) ==
+                     concurrent_hashmap_get(hm, (void*)i));
+    concurrent_hashmap_freeall(hm);
+}
+
+#define STABLE_KEYS 64
+
+static void *__reader(void *arg)
+{
+    worker_t *w = arg;
+    int round;
+    unsigned long i;
+
+    /* stable keys are never removed, and only ever get bit 16 set */
+    for (round = 0; round < 200; round++)
+        for (i = 1; i <= STABLE_KEYS; i++)
+        {
+            unsigned long v = (unsigned long)concurrent_hashmap_get(w->hm,
+                                                                   (void*)i);
+
+            if (v != i && v != (i | 0x10000))
+                w->failed = 1;
+        }
+    return NULL;
+}
+
+static void *__churner(void *arg)
+{
+    worker_t *w = arg;
+    unsigned long i;
+
+    for (i = w->first; i < w->first + PER_THREAD; i++)
+    {
+        concurrent_hashmap_put(w->hm, (void*)i, (void*)i);
+        concurrent_hashmap_put(w->hm, (void*)(i % STABLE_KEYS + 1),
+                               (void*)((i % STABLE_KEYS + 1) | 0x10000));
+        if (i % 3 == 0)
+            concurrent_hashmap_remove(w->hm, (void*)i);
+    }
+    return NULL;
+}
+
+void TestConcurrentHashmap_LockfreeReadersWhileWriting(
+    CuTest * tc
+    )
+{
+    concurrent_hashmap_t *hm;
+    pthread_t threads[NTHREADS];
+    worker_t workers[NTHREADS];
+    unsigned long i;
+    int t;
+
+    hm = concurrent_hashmap_new_with_flags(__uint_hash, __uint_compare, 4, 8,
+                                           CONCURRENT_HASHMAP_LOCKFREE_READS);
+    for (i = 1; i <= STABLE_KEYS; i++)
+        concurrent_hashmap_put(hm, (void*)i, (void*)i);
+
+    for (t = 0; t < NTHREADS; t++)
+    {
+        workers[t].hm = hm;
+        workers[t].first = 1000 + t * PER_THREAD;
+        workers[t].failed = 0;
+        pthread_create(&threads[t], NULL, t % 2 ? __churner : __reader,
+                       &workers[t]);
+    }
+    for (t = 0; t < NTHREADS; t++)
+    {
+        pthread_join(threads[t], NULL);
+        CuAssertTrue(tc, 0 == workers[t].failed);
+    }
+
+    for (t = 1; t < NTHREADS; t += 2)
+        for (i = workers[t].first; i < workers[t].first + PER_THREAD; i++)
+            CuAssertTrue(tc, (i % 3 ? (void*)i : NULL) ==
+                         concurrent_hashmap_get(hm, (void*)i));
+    concurrent_hashmap_freeall(hm);
+}
+
+void TestConcurrentHashmap_GrowLoad(
+    CuTest * tc
+    )
+{
+    concurrent_hashmap_t *hm;
+    void *table;
+    unsigned long i;
+
+    /* four to a bucket before the 16 buckets double */
+    hm = concurrent_hashmap_new(__uint_hash, __uint_compare, 16, 4);
+    concurrent_hashmap_set_grow_load(hm, 4);
+    table = hm->table;
+    for (i = 1; i < 64; i++)
+        concurrent_hashmap_put(hm, (void*)i, (void*)i);
+    CuAssertPtrEquals(tc, table, hm->table);
+    concurrent_hashmap_put(hm, (void*)64, (void*)64);
+    CuAssertTrue(tc, table != hm->table);
+    for (i = 1; i <= 64; i++)
+        CuAssertTrue(tc, i == (unsigned long)concurrent_hashmap_get(hm,
+                                                                 (void*)i));
+    concurrent_hashmap_freeall(hm);
+}
@@ -0,0 +1,208 @@
+#include <stdbool.h>
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "CuTest.h"
+
+#include "linked_list_hashmap.h"
+#include "hashmap_hashes.h"
+
+#define NBUCKETS 1024
+
+/* for 1023 degrees of freedom the chi-squared mean is 1023 and the
+ * standard deviation about 45; this is six of those above */
+#define CHI2_MAX 1300
+
+/**
+ * @return chi-squared of these hashes' spread over NBUCKETS, picked by
+ * either their low or their high bits */
+static double __chi2(const unsigned long *hashes, size_t n, int high)
+{
+    size_t counts[NBUCKETS] = { 0 }, i;
+    double expected = (double)n / NBUCKETS, chi2 = 0;
+
+    for (i = 0; i < n; i++)
+        counts[high ? hashes[i] >> (sizeof(unsigned long) * 8 - 10) :
+               hashes[i] & (NBUCKETS - 1)]++;
+    for (i = 0; i < NBUCKETS; i++)
+        chi2 += (counts[i] - expected) * (counts[i] - expected) / expected;
+    return chi2;
+}
+
+void TestHashes_SequentialKeysSpreadEvenly(
+    CuTest * tc
+    )
+{
+    size_t n = NBUCKETS * 64, i;
+    unsigned long *hashes = malloc(n * sizeof(unsigned long));
+    char str[32];
+    int high;
+
+    for (high = 0; high <= 1; high++)
+    {
+        for (i = 0; i < n; i++)
+            hashes[i] = hashmap_uintptr_hash((void*)(i + 1));
+        CuAssertTrue(tc, __chi2(hashes, n, high) < CHI2_MAX);
+
+        for (i = 0; i < n; i++)
+        {
+            uint32_t k = i * 4096;
+
+            hashes[i] = hashmap_u32_hash(&k);
+        }
+        CuAssertTrue(tc, __chi2(hashes, n, high) < CHI2_MAX);
+
+        for (i = 0; i < n; i++)
+        {
+            snprintf(str, sizeof(str), "key:%zu", i);
+            hashes[i] = hashmap_str_hash(str);
+        }
+        CuAssertTrue(tc, __chi2(hashes, n, high) < CHI2_MAX);
+    }
+    free(hashes);
+}
+
+/**
+ * Flip each bit of a random key, for many keys.
+ * @return 1 if every output bit flipped with every input bit between 40%
+ * and 60% of the time */
+static int __avalanches(size_t len)
+{
+    static unsigned int flips[64][64];
+    uint64_t x = 88172645463325252ULL;
+    unsigned char key[64], flipped[64];
+    size_t b, o, bits = len * 8 < 64 ? len * 8 : 64;
+    int i, n = 2000;
+
+    memset(flips, 0, sizeof(flips));
+    for (i = 0; i < n; i++)
+    {
+        unsigned long h;
+
+        for (b = 0; b < len; b++)
+        {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            key[b] = x;
+        }
+
+        h = hashmap_hash_bytes(key, len, 0);
+        for (b = 0; b < bits; b++)
+        {
+            unsigned long d;
+
+            /* spread the flipped bits over the whole key */
+            size_t at = b * len * 8 / bits;
+
+            memcpy(flipped, key, len);
+            flipped[at / 8] ^= 1 << (at % 8);
+            d = h ^ hashmap_hash_bytes(flipped, len, 0);
+            for (o = 0; o < 64; o++)
+                flips[b][o] += d >> o & 1;
+        }
+    }
+
+    for (b = 0; b < bits; b++)
+        for (o = 0; o < 64; o++)
+            if (flips[b][o] < n * 0.4 || n * 0.6 < flips[b][o])
+                return 0;
+    return 1;
+}
+
+void TestHashes_BytesAvalanche(
+    CuTest * tc
+    )
+{
+    /* each of the length classes the hash treats differently */
+    CuAssertTrue(tc, __avalanches(3));
+    CuAssertTrue(tc, __avalanches(8));
+    CuAssertTrue(tc, __avalanches(16));
+    CuAssertTrue(tc, __avalanches(40));
+    CuAssertTrue(tc, __avalanches(64));
+}
+
+void TestHashes_IntegerAvalanche(
+    CuTest * tc
+    )
+{
+    static unsigned int flips[64][64];
+    uint64_t x = 88172645463325252ULL;
+    size_t b, o;
+    int i, n = 2000, ok = 1;
+
+    for (i = 0; i < n; i++)
+    {
+        unsigned long h;
+
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        h = hashmap_u64_hash(&x);
+        for (b = 0; b < 64; b++)
+        {
+            uint64_t y = x ^ (1ULL << b);
+            unsigned long d = h ^ hashmap_u64_hash(&y);
+
+            for (o = 0; o < 64; o++)
+                flips[b][o] += d >> o & 1;
+        }
+    }
+
+    for (b = 0; b < 64; b++)
+        for (o = 0; o < 64; o++)
+            if (flips[b][o] < n * 0.4 || n * 0.6 < flips[b][o])
+                ok = 0;
+    CuAssertTrue(tc, ok);
+}
+
+void TestHashes_KeyKindsAgree(
+    CuTest * tc
+    )
+{
+    hashmap_bytes_t b1 = { "hello", 5 }, b2 = { "hello world", 5 },
+        b3 = { "hello", 4 };
+    uint32_t u32 = 7;
+    uint64_t u64 = 7;
+
+    CuAssertTrue(tc, hashmap_str_hash("hello") == hashmap_bytes_hash(&b1));
+    CuAssertTrue(tc, hashmap_bytes_hash(&b1) == hashmap_bytes_hash(&b2));
+    CuAssertTrue(tc, 0 == hashmap_bytes_compare(&b1, &b2));
+    CuAssertTrue(tc, 0 != hashmap_bytes_compare(&b1, &b3));
+    CuAssertTrue(tc, hashmap_str_hash("hello") !=
+                 hashmap_hash_bytes("hello", 5, 1));
+
+    /* integers hash the same whichever way they are held */
+    CuAssertTrue(tc, hashmap_u32_hash(&u32) == hashmap_u64_hash(&u64));
+    CuAssertTrue(tc, hashmap_u64_hash(&u64) == hashmap_uintptr_hash((void*)7));
+    CuAssertTrue(tc, 0 > hashmap_uintptr_compare((void*)1, (void*)-1));
+}
+
+void TestHashes_StringKeyedMap(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    char keys[100][16], probe[16];
+    int i;
+
+    hm = hashmap_new_with_flags(hashmap_str_hash, hashmap_str_compare, 11,
+                                HASHMAP_POW2);
+    for (i = 0; i < 100; i++)
+    {
+        snprintf(keys[i], sizeof(keys[i]), "key:%d", i);
+        hashmap_put(hm, keys[i], keys[i]);
+    }
+
+    /* equal strings at other addresses find the same entries */
+    for (i = 0; i < 100; i++)
+    {
+        snprintf(probe, sizeof(probe), "key:%d", i);
+        CuAssertTrue(tc, keys[i] == hashmap_get(hm, probe));
+    }
+    CuAssertTrue(tc, NULL == hashmap_get(hm, "key:100"));
+    hashmap_freeall(hm);
+}
@@ -0,0 +1,57 @@
+#include <stdbool.h>
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "CuTest.h"
+
+#include "hashmap_uint.h"
+
+void TestHashmapUint_ZeroKeysAndValues(
+    CuTest * tc
+    )
+{
+    hashmap_uint_t *hm;
+    uint64_t val = 1;
+
+    hm = hashmap_uint_new(0);
+    CuAssertTrue(tc, NULL == hashmap_uint_get(hm, 0));
+    CuAssertTrue(tc, 1 == hashmap_uint_put(hm, 0, 0));
+    CuAssertTrue(tc, 1 == hashmap_uint_put(hm, 1, 0));
+    CuAssertTrue(tc, 2 == hashmap_uint_count(hm));
+    CuAssertTrue(tc, 0 == *hashmap_uint_get(hm, 0));
+    CuAssertTrue(tc, 0 == *hashmap_uint_get(hm, 1));
+
+    CuAssertTrue(tc, 1 == hashmap_uint_remove(hm, 0, &val));
+    CuAssertTrue(tc, 0 == val);
+    CuAssertTrue(tc, NULL == hashmap_uint_get(hm, 0));
+    CuAssertTrue(tc, 1 == hashmap_uint_count(hm));
+    hashmap_uint_freeall(hm);
+}
+
+void TestHashmapUint_FullRangeOfKeys(
+    CuTest * tc
+    )
+{
+    hashmap_uint_t *hm;
+    hashmap_uint_iterator_t iter;
+    uint64_t i, key, val, n = 0;
+
+    hm = hashmap_uint_new(0);
+    /* the top bit is set on half of them */
+    for (i = 0; i < 10000; i++)
+        hashmap_uint_put(hm, i * 0x9e3779b97f4a7c15ULL, i);
+    for (i = 0; i < 10000; i++)
+        CuAssertTrue(tc, i == *hashmap_uint_get(hm, i * 0x9e3779b97f4a7c15ULL));
+
+    hashmap_uint_iterator(hm, &iter);
+    while (hashmap_uint_iterator_next(hm, &iter, &key, &val))
+    {
+        CuAssertTrue(tc, key == val * 0x9e3779b97f4a7c15ULL);
+        n++;
+    }
+    CuAssertTrue(tc, 10000 == n);
+    hashmap_uint_freeall(hm);
+}
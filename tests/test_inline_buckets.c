@@ -0,0 +1,215 @@
+#include <stdbool.h>
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "CuTest.h"
+
+#include "linked_list_hashmap.h"
+
+static unsigned long __uint_hash(
+    const void *e1
+    )
+{
+    const long i1 = (unsigned long)e1;
+
+    assert(i1 >= 0);
+    return i1;
+}
+
+/* every key in the same bucket, with the same tag */
+static unsigned long __zero_hash(
+    const void *e1 __attribute__((__unused__))
+    )
+{
+    return 0;
+}
+
+static long __uint_compare(
+    const void *e1,
+    const void *e2
+    )
+{
+    const long i1 = (unsigned long)e1, i2 = (unsigned long)e2;
+
+    return i1 - i2;
+}
+
+static hashmap_t *__new(func_longhash_f hash, size_t capacity)
+{
+    return hashmap_new_with_flags(hash, __uint_compare, capacity,
+                                  HASHMAP_INLINE_BUCKETS);
+}
+
+void TestHashmapInlineBuckets_PutGetRemove(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+
+    hm = __new(__uint_hash, 11);
+    CuAssertTrue(tc, 16 == hashmap_size(hm));
+    CuAssertTrue(tc, NULL == hashmap_put(hm, (void*)50, (void*)92));
+    CuAssertTrue(tc, 92 == (unsigned long)hashmap_put(hm, (void*)50,
+                                                      (void*)23));
+    CuAssertTrue(tc, 1 == hashmap_count(hm));
+    CuAssertTrue(tc, 23 == (unsigned long)hashmap_get(hm, (void*)50));
+    CuAssertTrue(tc, NULL == hashmap_get(hm, (void*)51));
+    CuAssertTrue(tc, NULL == hashmap_remove(hm, (void*)51));
+    CuAssertTrue(tc, 23 == (unsigned long)hashmap_remove(hm, (void*)50));
+    CuAssertTrue(tc, 0 == hashmap_count(hm));
+    CuAssertTrue(tc, NULL == hashmap_get(hm, (void*)50));
+    hashmap_freeall(hm);
+}
+
+void TestHashmapInlineBuckets_FullBucketsOverflow(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_stats_t stats;
+    unsigned long i;
+
+    /* big enough that 20 keys don't resize it */
+    hm = __new(__zero_hash, 64);
+    for (i = 1; i <= 20; i++)
+        hashmap_put(hm, (void*)i, (void*)(i + 1));
+    CuAssertTrue(tc, 64 == hashmap_size(hm));
+    for (i = 1; i <= 20; i++)
+        CuAssertTrue(tc, i + 1 == (unsigned long)hashmap_get(hm, (void*)i));
+
+    /* three entries inline, the rest on six overflow buckets */
+    hashmap_get_stats(hm, &stats);
+    CuAssertTrue(tc, 17 == stats.chained_nodes);
+    CuAssertTrue(tc, 7 == stats.max_chain);
+    CuAssertTrue(tc, 3 == stats.chains[1]);
+    CuAssertTrue(tc, (64 + 6) * 64 + sizeof(hashmap_t) == stats.bytes);
+
+    /* holes left by removes are filled again */
+    for (i = 1; i <= 20; i += 2)
+        CuAssertTrue(tc, i + 1 == (unsigned long)hashmap_remove(hm, (void*)i));
+    for (i = 21; i <= 30; i++)
+        hashmap_put(hm, (void*)i, (void*)(i + 1));
+    hashmap_get_stats(hm, &stats);
+    CuAssertTrue(tc, 20 == hashmap_count(hm));
+    CuAssertTrue(tc, (64 + 6) * 64 + sizeof(hashmap_t) == stats.bytes);
+    for (i = 1; i <= 30; i++)
+        CuAssertTrue(tc, (1 == i % 2 && i < 20) ==
+                     (NULL == hashmap_get(hm, (void*)i)));
+    hashmap_freeall(hm);
+}
+
+void TestHashmapInlineBuckets_ResizeKeepsEntries(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = __new(__uint_hash, 1);
+    for (i = 1; i <= 10000; i++)
+        hashmap_put(hm, (void*)i, (void*)(i + 1));
+    CuAssertTrue(tc, 10000 == hashmap_count(hm));
+    for (i = 1; i <= 10000; i++)
+        CuAssertTrue(tc, i + 1 == (unsigned long)hashmap_get(hm, (void*)i));
+
+    for (i = 1; i <= 9990; i++)
+        hashmap_remove(hm, (void*)i);
+    hashmap_shrink_to_fit(hm);
+    CuAssertTrue(tc, 8 == hashmap_size(hm));
+    for (i = 9991; i <= 10000; i++)
+        CuAssertTrue(tc, i + 1 == (unsigned long)hashmap_get(hm, (void*)i));
+    hashmap_freeall(hm);
+}
+
+void TestHashmapInlineBuckets_GrowLoadCanFillEveryBucket(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = __new(__uint_hash, 16);
+    hashmap_set_resize_policy(hm, 3, 2, 0.25);
+    for (i = 1; i <= 47; i++)
+        hashmap_put(hm, (void*)i, (void*)(i + 1));
+    CuAssertTrue(tc, 16 == hashmap_size(hm));
+    hashmap_put(hm, (void*)48, (void*)49);
+    CuAssertTrue(tc, 32 == hashmap_size(hm));
+    hashmap_put(hm, (void*)49, (void*)50);
+    for (i = 1; i <= 49; i++)
+        CuAssertTrue(tc, i + 1 == (unsigned long)hashmap_get(hm, (void*)i));
+
+    /* and shrinks back once a quarter full */
+    for (i = 1; i <= 42; i++)
+        hashmap_remove(hm, (void*)i);
+    CuAssertTrue(tc, hashmap_size(hm) < 32);
+    for (i = 43; i <= 49; i++)
+        CuAssertTrue(tc, i + 1 == (unsigned long)hashmap_get(hm, (void*)i));
+    hashmap_freeall(hm);
+}
+
+void TestHashmapInlineBuckets_IterateAndRemoveDoesntBreakIteration(
+    CuTest * tc
+    )
+{
+    func_longhash_f hashes[] = { __uint_hash, __zero_hash };
+    unsigned int f;
+
+    for (f = 0; f < sizeof(hashes) / sizeof(hashes[0]); f++)
+    {
+        hashmap_t *hm, *hm2;
+        hashmap_iterator_t iter;
+        unsigned long i;
+        void *key;
+
+        hm = __new(hashes[f], 64);
+        hm2 = __new(__uint_hash, 64);
+        for (i = 1; i <= 50; i++)
+        {
+            hashmap_put(hm, (void*)i, (void*)(i + 1));
+            hashmap_put(hm2, (void*)i, (void*)(i + 1));
+        }
+
+        /*  remove every key we iterate on */
+        hashmap_iterator(hm, &iter);
+        while ((key = hashmap_iterator_next(hm, &iter)))
+        {
+            CuAssertTrue(tc, NULL != hashmap_remove(hm2, key));
+            hashmap_remove(hm, key);
+        }
+
+        CuAssertTrue(tc, 0 == hashmap_count(hm2));
+        CuAssertTrue(tc, 0 == hashmap_count(hm));
+        hashmap_freeall(hm);
+        hashmap_freeall(hm2);
+    }
+}
+
+void TestHashmapInlineBuckets_ClearThenReuse(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_iterator_t iter;
+    hashmap_stats_t stats;
+    unsigned long i;
+
+    hm = __new(__zero_hash, 8);
+    for (i = 1; i <= 5; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    hashmap_clear(hm);
+    CuAssertTrue(tc, 0 == hashmap_count(hm));
+    CuAssertTrue(tc, NULL == hashmap_get(hm, (void*)5));
+    hashmap_iterator(hm, &iter);
+    CuAssertTrue(tc, 0 == hashmap_iterator_has_next(hm, &iter));
+
+    /* the overflow buckets went with the clear */
+    hashmap_get_stats(hm, &stats);
+    CuAssertTrue(tc, 8 * 64 + sizeof(hashmap_t) == stats.bytes);
+
+    hashmap_put(hm, (void*)7, (void*)8);
+    CuAssertTrue(tc, 8 == (unsigned long)hashmap_get(hm, (void*)7));
+    hashmap_freeall(hm);
+}
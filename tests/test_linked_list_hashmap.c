@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include "CuTest.h"
 
 #include "linked_list_hashmap.h"
@@ -330,6 +331,77 @@ void TestHashmaplinked_ClearHandlesCollision(
     hashmap_freeall(hm);
 }
 
+static unsigned long __zero_hash(
+    const void *e1 __attribute__((unused))
+    )
+{
+    return 0;
+}
+
+void TestHashmaplinked_ClearReusesChainNodes(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_iterator_t iter;
+    hashmap_node_pool_stats_t stats;
+    size_t capacity, slabs;
+    unsigned long i;
+
+    /* every key in one long chain */
+    hm = hashmap_new(__zero_hash, __uint_compare, 4);
+    for (i = 1; i <= 2000; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    hashmap_node_pool_stats(hm, &stats);
+    capacity = stats.capacity;
+    slabs = stats.slabs;
+
+    hashmap_clear(hm);
+    CuAssertTrue(tc, 0 == hashmap_count(hm));
+    CuAssertTrue(tc, NULL == hashmap_get(hm, (void*)1));
+    hashmap_iterator(hm, &iter);
+    CuAssertTrue(tc, !hashmap_iterator_has_next(hm, &iter));
+    hashmap_node_pool_stats(hm, &stats);
+    CuAssertTrue(tc, 0 == stats.in_use);
+    CuAssertTrue(tc, capacity == stats.available);
+
+    /* filling it again takes every node from the same slabs */
+    for (i = 1; i <= 2000; i++)
+        hashmap_put(hm, (void*)i, (void*)(i + 1));
+    for (i = 1; i <= 2000; i++)
+        CuAssertTrue(tc, i + 1 == (unsigned long)hashmap_get(hm, (void*)i));
+    hashmap_node_pool_stats(hm, &stats);
+    CuAssertTrue(tc, capacity == stats.capacity);
+    CuAssertTrue(tc, slabs == stats.slabs);
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_ClearDuringIncrementalResize(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 4,
+                                HASHMAP_POW2 | HASHMAP_INCREMENTAL);
+    /* the 513th put starts growing to 2048 buckets */
+    for (i = 1; i <= 513; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    CuAssertTrue(tc, 1 == hashmap_rehash_step(hm, 0));
+
+    hashmap_clear(hm);
+    CuAssertTrue(tc, 0 == hashmap_count(hm));
+    CuAssertTrue(tc, 0 == hashmap_rehash_step(hm, 1));
+    for (i = 1; i <= 1000; i++)
+        CuAssertTrue(tc, NULL == hashmap_get(hm, (void*)i));
+    for (i = 1; i <= 1000; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    for (i = 1; i <= 1000; i++)
+        CuAssertTrue(tc, i == (unsigned long)hashmap_get(hm, (void*)i));
+    hashmap_freeall(hm);
+}
+
 void TestHashmaplinked_DoesNotHaveNextForEmptyIterator(
     CuTest * tc
     )
@@ -482,3 +554,683 @@ void TestHashmaplinked_IterateAndRemoveDoesntBreakIteration(
     hashmap_freeall(hm2);
 }
 
+void TestHashmaplinked_IterateEntriesGivesKeyAndValue(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_iterator_t iter;
+    hashmap_entry_t *ety;
+    unsigned long keys = 0, vals = 0;
+
+    hm = hashmap_new(__uint_hash, __uint_compare, 4);
+    /*  the following 3 collide: */
+    hashmap_put(hm, (void*)1, (void*)92);
+    hashmap_put(hm, (void*)5, (void*)91);
+    hashmap_put(hm, (void*)9, (void*)90);
+    hashmap_put(hm, (void*)2, (void*)89);
+
+    hashmap_iterator(hm, &iter);
+    CuAssertTrue(tc, hashmap_get(hm, hashmap_iterator_peek(hm, &iter)) ==
+                 hashmap_iterator_peek_value(hm, &iter));
+    while ((ety = hashmap_iterator_next_entry(hm, &iter)))
+    {
+        CuAssertTrue(tc, ety->val == hashmap_get(hm, ety->key));
+        keys += (unsigned long)ety->key;
+        vals += (unsigned long)ety->val;
+    }
+    CuAssertTrue(tc, 17 == keys);
+    CuAssertTrue(tc, 362 == vals);
+    CuAssertTrue(tc, NULL == hashmap_iterator_next_entry(hm, &iter));
+
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_CollisionTakesNodeFromPool(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_node_pool_stats_t stats;
+
+    hm = hashmap_new(__uint_hash, __uint_compare, 4);
+    hashmap_put(hm, (void*)1, (void*)92);
+    hashmap_node_pool_stats(hm, &stats);
+    CuAssertTrue(tc, 0 == stats.in_use);
+
+    /* collides with 1 */
+    hashmap_put(hm, (void*)5, (void*)93);
+    hashmap_node_pool_stats(hm, &stats);
+    CuAssertTrue(tc, 1 == stats.in_use);
+    CuAssertTrue(tc, 1 == stats.slabs);
+    CuAssertTrue(tc, stats.capacity == stats.in_use + stats.available);
+
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_RemoveReturnsNodeToPool(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_node_pool_stats_t stats;
+    unsigned int capacity;
+
+    hm = hashmap_new(__uint_hash, __uint_compare, 4);
+    hashmap_put(hm, (void*)1, (void*)92);
+    hashmap_put(hm, (void*)5, (void*)93);
+    hashmap_node_pool_stats(hm, &stats);
+    capacity = stats.capacity;
+
+    hashmap_remove(hm, (void*)5);
+    hashmap_node_pool_stats(hm, &stats);
+    CuAssertTrue(tc, 0 == stats.in_use);
+    CuAssertTrue(tc, capacity == stats.available);
+
+    /* the node gets reused */
+    hashmap_put(hm, (void*)9, (void*)94);
+    hashmap_node_pool_stats(hm, &stats);
+    CuAssertTrue(tc, 1 == stats.in_use);
+    CuAssertTrue(tc, capacity == stats.capacity);
+    CuAssertTrue(tc, 94 == (unsigned long)hashmap_get(hm, (void*)9));
+
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_NodePoolReserve(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_node_pool_stats_t stats;
+    unsigned long i;
+
+    hm = hashmap_new(__uint_hash, __uint_compare, 4);
+    hashmap_node_pool_reserve(hm, 100);
+    hashmap_node_pool_stats(hm, &stats);
+    CuAssertTrue(tc, 100 <= stats.available);
+    CuAssertTrue(tc, 1 == stats.slabs);
+    CuAssertTrue(tc, 0 < stats.bytes);
+
+    /* reserving less than what is available doesn't allocate */
+    hashmap_node_pool_reserve(hm, 50);
+    hashmap_node_pool_stats(hm, &stats);
+    CuAssertTrue(tc, 1 == stats.slabs);
+
+    for (i = 1; i < 200; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    for (i = 1; i < 200; i++)
+        CuAssertTrue(tc, i == (unsigned long)hashmap_get(hm, (void*)i));
+    hashmap_node_pool_stats(hm, &stats);
+    CuAssertTrue(tc, stats.capacity == stats.in_use + stats.available);
+
+    hashmap_clear(hm);
+    hashmap_node_pool_stats(hm, &stats);
+    CuAssertTrue(tc, 0 == stats.in_use);
+
+    hashmap_freeall(hm);
+}
+
+static int __hash_calls = 0;
+
+static unsigned long __counting_uint_hash(
+    const void *e1
+    )
+{
+    __hash_calls++;
+    return __uint_hash(e1);
+}
+
+void TestHashmaplinked_IncreaseCapacityDoesNotRehashKeys(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+
+    hm = hashmap_new(__counting_uint_hash, __uint_compare, 4);
+    hashmap_put(hm, (void*)1, (void*)90);
+    hashmap_put(hm, (void*)5, (void*)91);
+    hashmap_put(hm, (void*)2, (void*)92);
+
+    __hash_calls = 0;
+    hashmap_increase_capacity(hm, 2);
+    CuAssertTrue(tc, 0 == __hash_calls);
+    CuAssertTrue(tc, 91 == (unsigned long)hashmap_get(hm, (void*)5));
+    CuAssertTrue(tc, 1 == __hash_calls);
+
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_Pow2NewRoundsUpSize(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 11,
+                                HASHMAP_POW2);
+    CuAssertTrue(tc, 0 == hashmap_count(hm));
+    CuAssertTrue(tc, 16 == hashmap_size(hm));
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_Pow2IncreaseCapacityKeepsPow2(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 4,
+                                HASHMAP_POW2);
+    for (i = 1; i <= 100; i++)
+        hashmap_put(hm, (void*)i, (void*)(i + 1000));
+
+    hashmap_increase_capacity(hm, 3);
+    CuAssertTrue(tc, 0 == (hashmap_size(hm) & (hashmap_size(hm) - 1)));
+    CuAssertTrue(tc, 100 == hashmap_count(hm));
+    for (i = 1; i <= 100; i++)
+        CuAssertTrue(tc, i + 1000 == (unsigned long)hashmap_get(hm, (void*)i));
+
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_Pow2SpreadsWeakHashes(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_node_pool_stats_t stats;
+    unsigned long i;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 1024,
+                                HASHMAP_POW2);
+
+    /* without mixing these would all land in bucket 0 */
+    for (i = 1; i <= 32; i++)
+        hashmap_put(hm, (void*)(i * 1024), (void*)i);
+
+    hashmap_node_pool_stats(hm, &stats);
+    CuAssertTrue(tc, stats.in_use < 4);
+    for (i = 1; i <= 32; i++)
+        CuAssertTrue(tc, i == (unsigned long)hashmap_get(hm, (void*)(i * 1024)));
+
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_HoldsMoreThan32768Items(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = hashmap_new(__uint_hash, __uint_compare, 11);
+    for (i = 1; i <= 100000; i++)
+        hashmap_put(hm, (void*)i, (void*)(i + 1));
+
+    CuAssertTrue(tc, 100000 == hashmap_count(hm));
+    for (i = 1; i <= 100000; i++)
+        CuAssertTrue(tc, i + 1 == (unsigned long)hashmap_get(hm, (void*)i));
+
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_IncrementalPutStartsResizeWithoutMovingEverything(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 64,
+                                HASHMAP_POW2 | HASHMAP_INCREMENTAL);
+    for (i = 1; i <= 33; i++)
+        hashmap_put(hm, (void*)i, (void*)(i + 100));
+
+    /* the 33rd put started a resize, but some keys are still to move */
+    CuAssertTrue(tc, 128 == hashmap_size(hm));
+    CuAssertTrue(tc, 33 == hashmap_count(hm));
+    CuAssertTrue(tc, 1 == hashmap_rehash_step(hm, 0));
+
+    /* gets look in both arrays */
+    for (i = 1; i <= 33; i++)
+        CuAssertTrue(tc, i + 100 == (unsigned long)hashmap_get(hm, (void*)i));
+
+    while (hashmap_rehash_step(hm, 1))
+        ;
+    CuAssertTrue(tc, 33 == hashmap_count(hm));
+    for (i = 1; i <= 33; i++)
+        CuAssertTrue(tc, i + 100 == (unsigned long)hashmap_get(hm, (void*)i));
+
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_IncrementalPutReplacesKeyNotYetMoved(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 64,
+                                HASHMAP_POW2 | HASHMAP_INCREMENTAL);
+    for (i = 1; i <= 33; i++)
+        hashmap_put(hm, (void*)i, (void*)(i + 100));
+
+    for (i = 1; i <= 33; i++)
+        CuAssertTrue(tc, i + 100 ==
+                     (unsigned long)hashmap_put(hm, (void*)i, (void*)i));
+    CuAssertTrue(tc, 33 == hashmap_count(hm));
+    for (i = 1; i <= 33; i++)
+        CuAssertTrue(tc, i == (unsigned long)hashmap_get(hm, (void*)i));
+
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_IncrementalRemoveDuringResize(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 64,
+                                HASHMAP_POW2 | HASHMAP_INCREMENTAL);
+    for (i = 1; i <= 33; i++)
+        hashmap_put(hm, (void*)i, (void*)(i + 100));
+    CuAssertTrue(tc, 1 == hashmap_rehash_step(hm, 0));
+
+    for (i = 1; i <= 33; i++)
+        CuAssertTrue(tc, i + 100 == (unsigned long)hashmap_remove(hm, (void*)i));
+    CuAssertTrue(tc, 0 == hashmap_count(hm));
+    CuAssertTrue(tc, NULL == hashmap_get(hm, (void*)1));
+
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_IncrementalIterateDuringResize(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm, *hm2;
+    hashmap_iterator_t iter;
+    unsigned long i;
+    void *key;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 64,
+                                HASHMAP_POW2 | HASHMAP_INCREMENTAL);
+    hm2 = hashmap_new(__uint_hash, __uint_compare, 64);
+    for (i = 1; i <= 33; i++)
+    {
+        hashmap_put(hm, (void*)i, (void*)(i + 100));
+        hashmap_put(hm2, (void*)i, (void*)(i + 100));
+    }
+    CuAssertTrue(tc, 1 == hashmap_rehash_step(hm, 0));
+
+    /*  remove every key we iterate on */
+    hashmap_iterator(hm, &iter);
+    while ((key = hashmap_iterator_next(hm, &iter)))
+    {
+        CuAssertTrue(tc, NULL != hashmap_remove(hm2, key));
+        hashmap_remove(hm, key);
+    }
+    CuAssertTrue(tc, 0 == hashmap_count(hm2));
+    CuAssertTrue(tc, 0 == hashmap_count(hm));
+
+    hashmap_freeall(hm);
+    hashmap_freeall(hm2);
+}
+
+void TestHashmaplinked_IncrementalManyPuts(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 4,
+                                HASHMAP_INCREMENTAL);
+    for (i = 1; i <= 10000; i++)
+        hashmap_put(hm, (void*)i, (void*)(i + 1));
+
+    CuAssertTrue(tc, 10000 == hashmap_count(hm));
+    for (i = 1; i <= 10000; i++)
+        CuAssertTrue(tc, i + 1 == (unsigned long)hashmap_get(hm, (void*)i));
+
+    hashmap_clear(hm);
+    CuAssertTrue(tc, 0 == hashmap_rehash_step(hm, 0));
+    CuAssertTrue(tc, NULL == hashmap_get(hm, (void*)1));
+
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_GetMany(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    const void *keys[40];
+    void *vals[40];
+    unsigned long i;
+
+    hm = hashmap_new(__uint_hash, __uint_compare, 11);
+    for (i = 1; i <= 30; i++)
+        hashmap_put(hm, (void*)i, (void*)(i + 100));
+
+    /* more than a batch, with some misses and a NULL key */
+    for (i = 0; i < 40; i++)
+        keys[i] = (void*)i;
+    hashmap_get_many(hm, keys, vals, 40);
+
+    CuAssertTrue(tc, NULL == vals[0]);
+    for (i = 1; i <= 30; i++)
+        CuAssertTrue(tc, i + 100 == (unsigned long)vals[i]);
+    for (i = 31; i < 40; i++)
+        CuAssertTrue(tc, NULL == vals[i]);
+
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_PutMany(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    void *keys[40], *vals[40];
+    unsigned long i;
+
+    hm = hashmap_new(__uint_hash, __uint_compare, 4);
+    for (i = 0; i < 40; i++)
+    {
+        keys[i] = (void*)(i + 1);
+        vals[i] = (void*)(i + 101);
+    }
+    /* NULL vals get skipped */
+    vals[7] = NULL;
+    hashmap_put_many(hm, keys, vals, 40);
+
+    CuAssertTrue(tc, 39 == hashmap_count(hm));
+    CuAssertTrue(tc, NULL == hashmap_get(hm, (void*)8));
+    for (i = 0; i < 40; i++)
+        if (7 != i)
+            CuAssertTrue(tc, i + 101 ==
+                         (unsigned long)hashmap_get(hm, (void*)(i + 1)));
+
+    hashmap_freeall(hm);
+}
+
+
+void TestHashmaplinked_GrowLoadIsHonoured(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 16,
+                                HASHMAP_POW2);
+    /* chains can hold more entries than there are buckets */
+    hashmap_set_resize_policy(hm, 2.0, 4, 0);
+    for (i = 1; i <= 32; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    CuAssertTrue(tc, 16 == hashmap_size(hm));
+
+    hashmap_put(hm, (void*)33, (void*)33);
+    CuAssertTrue(tc, 64 == hashmap_size(hm));
+    for (i = 1; i <= 33; i++)
+        CuAssertTrue(tc, i == (unsigned long)hashmap_get(hm, (void*)i));
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_ShrinksAfterRemoves(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 16,
+                                HASHMAP_POW2);
+    hashmap_set_resize_policy(hm, 0.5, 2, 0.125);
+    for (i = 1; i <= 1000; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    CuAssertTrue(tc, 2048 == hashmap_size(hm));
+
+    for (i = 1; i <= 990; i++)
+        hashmap_remove(hm, (void*)i);
+    CuAssertTrue(tc, hashmap_size(hm) <= 64);
+    for (i = 991; i <= 1000; i++)
+        CuAssertTrue(tc, i == (unsigned long)hashmap_get(hm, (void*)i));
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_ShrinkToFit(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = hashmap_new(__uint_hash, __uint_compare, 11);
+    for (i = 1; i <= 1000; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    for (i = 1; i <= 990; i++)
+        hashmap_remove(hm, (void*)i);
+    /* shrinking is off by default */
+    CuAssertTrue(tc, 1000 < hashmap_size(hm));
+
+    hashmap_shrink_to_fit(hm);
+    CuAssertTrue(tc, 21 == hashmap_size(hm));
+    for (i = 991; i <= 1000; i++)
+        CuAssertTrue(tc, i == (unsigned long)hashmap_get(hm, (void*)i));
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_ReserveMeansNoResizes(
+    CuTest * tc
+    )
+{
+    int flags[] = { 0, HASHMAP_POW2, HASHMAP_OPEN_ADDRESSING, HASHMAP_ORDERED };
+    unsigned int f;
+
+    for (f = 0; f < sizeof(flags) / sizeof(flags[0]); f++)
+    {
+        hashmap_t *hm;
+        unsigned long i;
+        size_t size;
+
+        hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 4, flags[f]);
+        hashmap_put(hm, (void*)1, (void*)1);
+        hashmap_reserve(hm, 5000);
+        size = hashmap_size(hm);
+        CuAssertTrue(tc, 1 == (unsigned long)hashmap_get(hm, (void*)1));
+
+        for (i = 2; i <= 5000; i++)
+            hashmap_put(hm, (void*)i, (void*)i);
+        CuAssertTrue(tc, size == hashmap_size(hm));
+        CuAssertTrue(tc, 5000 == hashmap_count(hm));
+
+        /* never shrinks */
+        hashmap_reserve(hm, 10);
+        CuAssertTrue(tc, size == hashmap_size(hm));
+        hashmap_freeall(hm);
+    }
+}
+
+void TestHashmaplinked_StatsDescribeChains(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_stats_t stats;
+
+    /* 1, 12 and 23 all land in bucket 1 */
+    hm = hashmap_new(__uint_hash, __uint_compare, 11);
+    hashmap_put(hm, (void*)1, (void*)1);
+    hashmap_put(hm, (void*)12, (void*)12);
+    hashmap_put(hm, (void*)23, (void*)23);
+
+    hashmap_get_stats(hm, &stats);
+    CuAssertTrue(tc, 10 == stats.chains[0]);
+    CuAssertTrue(tc, 1 == stats.chains[3]);
+    CuAssertTrue(tc, 3 == stats.max_chain);
+    CuAssertTrue(tc, 2 == stats.chained_nodes);
+    CuAssertTrue(tc, 0 == stats.resizes);
+    CuAssertTrue(tc, sizeof(hashmap_t) < stats.bytes);
+
+#ifdef HASHMAP_STATS
+    hashmap_get(hm, (void*)1);
+    hashmap_get(hm, (void*)23);
+    hashmap_get(hm, (void*)2);
+    hashmap_get(hm, (void*)34);
+    hashmap_get_stats(hm, &stats);
+    CuAssertTrue(tc, 4 == stats.lookups);
+    CuAssertTrue(tc, 2 == stats.misses);
+    /* (1 + 3 + 1 + 3) / 4, and (1 + 3) / 2 */
+    CuAssertTrue(tc, 2.0 == stats.probes_per_lookup);
+    CuAssertTrue(tc, 2.0 == stats.probes_per_miss);
+#endif
+
+    hashmap_increase_capacity(hm, 2);
+    hashmap_get_stats(hm, &stats);
+    CuAssertTrue(tc, 1 == stats.resizes);
+    CuAssertTrue(tc, 0 <= stats.resize_seconds);
+    hashmap_freeall(hm);
+}
+
+void TestHashmaplinked_StatsAddUpOnEveryBackend(
+    CuTest * tc
+    )
+{
+    int flags[] = { 0, HASHMAP_POW2, HASHMAP_POW2 | HASHMAP_INCREMENTAL,
+        HASHMAP_OPEN_ADDRESSING, HASHMAP_ORDERED, HASHMAP_INLINE_BUCKETS };
+    unsigned int f;
+
+    for (f = 0; f < sizeof(flags) / sizeof(flags[0]); f++)
+    {
+        hashmap_t *hm;
+        hashmap_stats_t stats;
+        unsigned long i;
+        size_t chains = 0, entries = 0;
+
+        hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 4, flags[f]);
+        for (i = 1; i <= 1000; i++)
+            hashmap_put(hm, (void*)i, (void*)i);
+        hashmap_get_stats(hm, &stats);
+
+        for (i = 0; i < HASHMAP_STATS_CHAINS; i++)
+        {
+            chains += stats.chains[i];
+            entries += i * stats.chains[i];
+        }
+        /* chained maps count buckets, the others count entries */
+        if (flags[f] & (HASHMAP_OPEN_ADDRESSING | HASHMAP_ORDERED |
+                        HASHMAP_INLINE_BUCKETS))
+            CuAssertTrue(tc, 1000 == chains);
+        else
+        {
+            /* chains this short don't share the last count */
+            CuAssertTrue(tc, stats.max_chain < HASHMAP_STATS_CHAINS);
+            CuAssertTrue(tc, 1000 == entries);
+        }
+        CuAssertTrue(tc, stats.chained_nodes < 1000);
+        CuAssertTrue(tc, 0 < stats.resizes);
+        CuAssertTrue(tc, 1000 * sizeof(hashmap_entry_t) < stats.bytes);
+
+#ifdef HASHMAP_STATS
+        for (i = 1; i <= 2000; i++)
+            hashmap_get(hm, (void*)i);
+        hashmap_get_stats(hm, &stats);
+        CuAssertTrue(tc, 2000 == stats.lookups);
+        CuAssertTrue(tc, 1000 == stats.misses);
+        CuAssertTrue(tc, 1 <= stats.probes_per_lookup);
+        CuAssertTrue(tc, 1 <= stats.probes_per_miss);
+#endif
+        hashmap_freeall(hm);
+    }
+}
+
+static void __sum_keys(hashmap_entry_t * ety, void *ctx)
+{
+    unsigned long *sums = ctx;
+
+    sums[0]++;
+    sums[1] += (unsigned long)ety->key;
+}
+
+void TestHashmaplinked_ForEachRangesCoverEveryEntryOnce(
+    CuTest * tc
+    )
+{
+    int flags[] = { 0, HASHMAP_POW2 | HASHMAP_INCREMENTAL,
+        HASHMAP_OPEN_ADDRESSING, HASHMAP_ORDERED, HASHMAP_INLINE_BUCKETS };
+    unsigned int f;
+
+    for (f = 0; f < sizeof(flags) / sizeof(flags[0]); f++)
+    {
+        hashmap_t *hm;
+        unsigned long i, sums[2] = { 0, 0 }, expected = 0;
+        size_t pos, end;
+
+        /* 513 puts leave an incremental resize part way through */
+        hm = hashmap_new_with_flags(__uint_hash, __uint_compare, 4, flags[f]);
+        for (i = 1; i <= 513; i++)
+            hashmap_put(hm, (void*)i, (void*)i);
+        for (i = 1; i <= 513; i += 3)
+            hashmap_remove(hm, (void*)i);
+        for (i = 1; i <= 513; i++)
+            if (0 != (i - 1) % 3)
+                expected += i;
+
+        end = hashmap_range_end(hm);
+        for (pos = 0; pos < end; pos += 7)
+            hashmap_for_each_range(hm, pos, pos + 7, __sum_keys, sums);
+        CuAssertTrue(tc, hashmap_count(hm) == sums[0]);
+        CuAssertTrue(tc, expected == sums[1]);
+
+        /* nothing past the end */
+        hashmap_for_each_range(hm, end, end + 100, __sum_keys, sums);
+        CuAssertTrue(tc, hashmap_count(hm) == sums[0]);
+        hashmap_freeall(hm);
+    }
+}
+
+static void *__get_all(void *arg)
+{
+    hashmap_t *hm = arg;
+    unsigned long i;
+
+    for (i = 1; i <= 20000; i++)
+        hashmap_get(hm, (void*)i);
+    return NULL;
+}
+
+void TestHashmaplinked_StatsCountGetsFromManyThreads(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_stats_t stats;
+    pthread_t threads[4];
+    unsigned long i;
+    int t;
+
+    hm = hashmap_new(__uint_hash, __uint_compare, 11);
+    for (i = 1; i <= 10000; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    for (t = 0; t < 4; t++)
+        pthread_create(&threads[t], NULL, __get_all, hm);
+    for (t = 0; t < 4; t++)
+        pthread_join(threads[t], NULL);
+    CuAssertTrue(tc, 10000 == hashmap_count(hm));
+
+#ifdef HASHMAP_STATS
+    hashmap_get_stats(hm, &stats);
+    CuAssertTrue(tc, 4 * 20000 == stats.lookups);
+    CuAssertTrue(tc, 4 * 10000 == stats.misses);
+#else
+    (void)stats;
+#endif
+    hashmap_freeall(hm);
+}
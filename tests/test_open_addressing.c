@@ -0,0 +1,249 @@
+#include <stdbool.h>
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "CuTest.h"
+
+#include "linked_list_hashmap.h"
+
+static unsigned long __uint_hash(
+    const void *e1
+    )
+{
+    const long i1 = (unsigned long)e1;
+
+    assert(i1 >= 0);
+    return i1;
+}
+
+static long __uint_compare(
+    const void *e1,
+    const void *e2
+    )
+{
+    const long i1 = (unsigned long)e1, i2 = (unsigned long)e2;
+
+    return i1 - i2;
+}
+
+static hashmap_t *__new(size_t capacity)
+{
+    return hashmap_new_with_flags(__uint_hash, __uint_compare, capacity,
+                                  HASHMAP_OPEN_ADDRESSING);
+}
+
+void TestHashmapOpenAddressing_New(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+
+    hm = __new(11);
+    CuAssertTrue(tc, 0 == hashmap_count(hm));
+    /* at least one group of slots */
+    CuAssertTrue(tc, 16 == hashmap_size(hm));
+    hashmap_freeall(hm);
+}
+
+void TestHashmapOpenAddressing_PutAndGet(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+
+    hm = __new(16);
+    CuAssertTrue(tc, NULL == hashmap_put(hm, (void*)50, (void*)92));
+    CuAssertTrue(tc, 1 == hashmap_count(hm));
+    CuAssertTrue(tc, 92 == (unsigned long)hashmap_get(hm, (void*)50));
+    CuAssertTrue(tc, NULL == hashmap_get(hm, (void*)51));
+    CuAssertTrue(tc, 1 == hashmap_contains_key(hm, (void*)50));
+    hashmap_freeall(hm);
+}
+
+void TestHashmapOpenAddressing_DoublePut(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+
+    hm = __new(16);
+    hashmap_put(hm, (void*)50, (void*)92);
+    CuAssertTrue(tc, 92 == (unsigned long)hashmap_put(hm, (void*)50, (void*)23));
+    CuAssertTrue(tc, 23 == (unsigned long)hashmap_get(hm, (void*)50));
+    CuAssertTrue(tc, 1 == hashmap_count(hm));
+    hashmap_freeall(hm);
+}
+
+void TestHashmapOpenAddressing_Remove(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+
+    hm = __new(16);
+    hashmap_put(hm, (void*)50, (void*)92);
+    CuAssertTrue(tc, NULL == hashmap_remove(hm, (void*)51));
+    CuAssertTrue(tc, 92 == (unsigned long)hashmap_remove(hm, (void*)50));
+    CuAssertTrue(tc, 0 == hashmap_count(hm));
+    CuAssertTrue(tc, NULL == hashmap_get(hm, (void*)50));
+    hashmap_freeall(hm);
+}
+
+void TestHashmapOpenAddressing_PutEnsuresCapacity(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = __new(16);
+    for (i = 1; i <= 1000; i++)
+        hashmap_put(hm, (void*)i, (void*)(i + 1));
+
+    CuAssertTrue(tc, 1000 == hashmap_count(hm));
+    CuAssertTrue(tc, 1000 < hashmap_size(hm));
+    for (i = 1; i <= 1000; i++)
+        CuAssertTrue(tc, i + 1 == (unsigned long)hashmap_get(hm, (void*)i));
+    hashmap_freeall(hm);
+}
+
+void TestHashmapOpenAddressing_IncreaseCapacityDoesNotBreakHashmap(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = __new(16);
+    for (i = 1; i <= 10; i++)
+        hashmap_put(hm, (void*)i, (void*)(i + 1));
+    hashmap_increase_capacity(hm, 2);
+    CuAssertTrue(tc, 32 == hashmap_size(hm));
+    CuAssertTrue(tc, 10 == hashmap_count(hm));
+    for (i = 1; i <= 10; i++)
+        CuAssertTrue(tc, i + 1 == (unsigned long)hashmap_get(hm, (void*)i));
+    hashmap_freeall(hm);
+}
+
+void TestHashmapOpenAddressing_DeletesDontFillTheArray(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = __new(64);
+
+    /* tombstones get swept out instead of growing the array */
+    for (i = 1; i <= 100000; i++)
+    {
+        hashmap_put(hm, (void*)i, (void*)i);
+        if (10 < i)
+            CuAssertTrue(tc, i - 10 ==
+                         (unsigned long)hashmap_remove(hm, (void*)(i - 10)));
+    }
+
+    CuAssertTrue(tc, 10 == hashmap_count(hm));
+    CuAssertTrue(tc, 64 == hashmap_size(hm));
+    for (i = 100000 - 9; i <= 100000; i++)
+        CuAssertTrue(tc, i == (unsigned long)hashmap_get(hm, (void*)i));
+    hashmap_freeall(hm);
+}
+
+void TestHashmapOpenAddressing_Clear(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = __new(16);
+    for (i = 1; i <= 100; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    hashmap_clear(hm);
+    CuAssertTrue(tc, 0 == hashmap_count(hm));
+    CuAssertTrue(tc, NULL == hashmap_get(hm, (void*)1));
+    hashmap_put(hm, (void*)1, (void*)2);
+    CuAssertTrue(tc, 2 == (unsigned long)hashmap_get(hm, (void*)1));
+    hashmap_freeall(hm);
+}
+
+void TestHashmapOpenAddressing_IterateAndRemoveDoesntBreakIteration(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm, *hm2;
+    hashmap_iterator_t iter;
+    unsigned long i;
+    void *key;
+
+    hm = __new(16);
+    hm2 = __new(16);
+    for (i = 1; i <= 100; i++)
+    {
+        hashmap_put(hm, (void*)i, (void*)(i + 1));
+        hashmap_put(hm2, (void*)i, (void*)(i + 1));
+    }
+
+    /*  remove every key we iterate on */
+    hashmap_iterator(hm, &iter);
+    while ((key = hashmap_iterator_next(hm, &iter)))
+    {
+        CuAssertTrue(tc, NULL != hashmap_remove(hm2, key));
+        hashmap_remove(hm, key);
+    }
+
+    CuAssertTrue(tc, 0 == hashmap_count(hm2));
+    CuAssertTrue(tc, 0 == hashmap_count(hm));
+    hashmap_freeall(hm);
+    hashmap_freeall(hm2);
+}
+
+void TestHashmapOpenAddressing_GetMany(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    const void *keys[40];
+    void *vals[40];
+    unsigned long i;
+
+    hm = __new(16);
+    for (i = 1; i <= 30; i++)
+        hashmap_put(hm, (void*)i, (void*)(i + 100));
+
+    for (i = 0; i < 40; i++)
+        keys[i] = (void*)i;
+    hashmap_get_many(hm, keys, vals, 40);
+
+    CuAssertTrue(tc, NULL == vals[0]);
+    for (i = 1; i <= 30; i++)
+        CuAssertTrue(tc, i + 100 == (unsigned long)vals[i]);
+    for (i = 31; i < 40; i++)
+        CuAssertTrue(tc, NULL == vals[i]);
+    hashmap_freeall(hm);
+}
+
+void TestHashmapOpenAddressing_ShrinkToFit(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = __new(16);
+    for (i = 1; i <= 1000; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    for (i = 1; i <= 990; i++)
+        hashmap_remove(hm, (void*)i);
+
+    hashmap_shrink_to_fit(hm);
+    /* never below one group */
+    CuAssertTrue(tc, 16 == hashmap_size(hm));
+    CuAssertTrue(tc, 0 == hm->tombstones);
+    for (i = 991; i <= 1000; i++)
+        CuAssertTrue(tc, i == (unsigned long)hashmap_get(hm, (void*)i));
+    hashmap_freeall(hm);
+}
@@ -0,0 +1,158 @@
+#include <stdbool.h>
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "CuTest.h"
+
+#include "linked_list_hashmap.h"
+
+static unsigned long __uint_hash(
+    const void *e1
+    )
+{
+    const long i1 = (unsigned long)e1;
+
+    assert(i1 >= 0);
+    return i1;
+}
+
+static long __uint_compare(
+    const void *e1,
+    const void *e2
+    )
+{
+    const long i1 = (unsigned long)e1, i2 = (unsigned long)e2;
+
+    return i1 - i2;
+}
+
+static hashmap_t *__new(size_t capacity)
+{
+    return hashmap_new_with_flags(__uint_hash, __uint_compare, capacity,
+                                  HASHMAP_ORDERED);
+}
+
+void TestHashmapOrdered_PutGetRemove(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+
+    hm = __new(8);
+    CuAssertTrue(tc, NULL == hashmap_put(hm, (void*)50, (void*)92));
+    CuAssertTrue(tc, 92 == (unsigned long)hashmap_put(hm, (void*)50, (void*)23));
+    CuAssertTrue(tc, 1 == hashmap_count(hm));
+    CuAssertTrue(tc, 23 == (unsigned long)hashmap_get(hm, (void*)50));
+    CuAssertTrue(tc, NULL == hashmap_get(hm, (void*)51));
+
+    CuAssertTrue(tc, NULL == hashmap_remove(hm, (void*)51));
+    CuAssertTrue(tc, 23 == (unsigned long)hashmap_remove(hm, (void*)50));
+    CuAssertTrue(tc, 0 == hashmap_count(hm));
+    CuAssertTrue(tc, NULL == hashmap_get(hm, (void*)50));
+    hashmap_freeall(hm);
+}
+
+void TestHashmapOrdered_IteratesInInsertionOrder(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_iterator_t iter;
+    hashmap_entry_t *ety;
+    unsigned long i, expected;
+
+    hm = __new(8);
+    /* descending, so that hash order can't pass for insertion order */
+    for (i = 1000; 0 < i; i--)
+        hashmap_put(hm, (void*)i, (void*)(i + 1));
+    for (i = 1; i <= 1000; i += 3)
+        hashmap_remove(hm, (void*)i);
+    /* replacing a value doesn't move its entry */
+    hashmap_put(hm, (void*)2, (void*)3);
+
+    expected = 1000;
+    hashmap_iterator(hm, &iter);
+    while ((ety = hashmap_iterator_next_entry(hm, &iter)))
+    {
+        if (expected % 3 == 1)
+            expected--;
+        CuAssertTrue(tc, expected == (unsigned long)ety->key);
+        CuAssertTrue(tc, expected + 1 == (unsigned long)ety->val);
+        expected--;
+    }
+    /* 1 was removed, so 2 was the last */
+    CuAssertTrue(tc, 1 == expected);
+    hashmap_freeall(hm);
+}
+
+void TestHashmapOrdered_RemoveWhileIterating(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_iterator_t iter;
+    void *key;
+    unsigned long i;
+    int n = 0;
+
+    hm = __new(8);
+    for (i = 1; i <= 100; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+
+    hashmap_iterator(hm, &iter);
+    while ((key = hashmap_iterator_next(hm, &iter)))
+    {
+        CuAssertTrue(tc, NULL != hashmap_remove(hm, key));
+        n++;
+    }
+    CuAssertTrue(tc, 100 == n);
+    CuAssertTrue(tc, 0 == hashmap_count(hm));
+    hashmap_freeall(hm);
+}
+
+void TestHashmapOrdered_ChurnDoesNotGrow(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = __new(64);
+    /* removed entries leave holes that get squeezed out, not grown past */
+    for (i = 1; i <= 10000; i++)
+    {
+        hashmap_put(hm, (void*)i, (void*)i);
+        if (10 < i)
+            CuAssertTrue(tc, i - 10 ==
+                         (unsigned long)hashmap_remove(hm, (void*)(i - 10)));
+    }
+    CuAssertTrue(tc, 10 == hashmap_count(hm));
+    CuAssertTrue(tc, 64 == hashmap_size(hm));
+    for (i = 9991; i <= 10000; i++)
+        CuAssertTrue(tc, i == (unsigned long)hashmap_get(hm, (void*)i));
+    hashmap_freeall(hm);
+}
+
+void TestHashmapOrdered_ClearThenReuse(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_iterator_t iter;
+    unsigned long i;
+
+    hm = __new(8);
+    for (i = 1; i <= 100; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    hashmap_clear(hm);
+    CuAssertTrue(tc, 0 == hashmap_count(hm));
+    CuAssertTrue(tc, NULL == hashmap_get(hm, (void*)5));
+    hashmap_iterator(hm, &iter);
+    CuAssertTrue(tc, 0 == hashmap_iterator_has_next(hm, &iter));
+
+    hashmap_put(hm, (void*)7, (void*)8);
+    CuAssertTrue(tc, 8 == (unsigned long)hashmap_get(hm, (void*)7));
+    hashmap_freeall(hm);
+}
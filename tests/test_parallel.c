@@ -0,0 +1,217 @@
+#include <stdbool.h>
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "CuTest.h"
+
+#include "linked_list_hashmap.h"
+#include "hashmap_hashes.h"
+#include "hashmap_parallel.h"
+
+/**
+ * @return entries for keys 1 to n / 2 twice over, with every 1000th entry
+ * missing its value */
+static hashmap_entry_t *__entries(size_t n)
+{
+    hashmap_entry_t *entries = malloc(n * sizeof(hashmap_entry_t));
+    unsigned long i;
+
+    for (i = 0; i < n; i++)
+    {
+        entries[i].key = (void*)(i % (n / 2) + 1);
+        entries[i].val = 0 == i % 1000 ? NULL : (void*)(i + 1);
+    }
+    return entries;
+}
+
+void TestParallel_BuildIsLikePuttingInOrder(
+    CuTest * tc
+    )
+{
+    hashmap_entry_t *entries = __entries(200000);
+    hashmap_node_pool_stats_t stats;
+    hashmap_t *hm, *expected;
+    unsigned long i;
+
+    expected = hashmap_new(hashmap_uintptr_hash, hashmap_uintptr_compare, 11);
+    for (i = 0; i < 200000; i++)
+        hashmap_put(expected, entries[i].key, entries[i].val);
+
+    hm = hashmap_build_parallel(hashmap_uintptr_hash, hashmap_uintptr_compare,
+                                entries, 200000, 4, 0);
+    CuAssertTrue(tc, hashmap_count(expected) == hashmap_count(hm));
+    for (i = 1; i <= 100000; i++)
+        CuAssertTrue(tc, hashmap_get(expected, (void*)i) ==
+                     hashmap_get(hm, (void*)i));
+
+    hashmap_node_pool_stats(hm, &stats);
+    CuAssertTrue(tc, 0 < stats.in_use);
+    CuAssertTrue(tc, stats.capacity == stats.in_use + stats.available);
+
+    hashmap_freeall(expected);
+    hashmap_freeall(hm);
+    free(entries);
+}
+
+void TestParallel_BuiltMapCarriesOn(
+    CuTest * tc
+    )
+{
+    hashmap_entry_t *entries = __entries(100000);
+    hashmap_node_pool_stats_t stats;
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = hashmap_build_parallel(hashmap_uintptr_hash, hashmap_uintptr_compare,
+                                entries, 100000, 3, HASHMAP_INCREMENTAL);
+
+    /* puts and removes use the chain nodes the threads took */
+    for (i = 1; i <= 50000; i += 2)
+        hashmap_remove(hm, (void*)i);
+    for (i = 50001; i <= 200000; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    for (i = 1; i <= 200000; i++)
+        CuAssertTrue(tc, (1 == i % 2 && i <= 50000) ==
+                     (NULL == hashmap_get(hm, (void*)i)));
+    hashmap_node_pool_stats(hm, &stats);
+    CuAssertTrue(tc, stats.capacity == stats.in_use + stats.available);
+
+    hashmap_clear(hm);
+    for (i = 1; i <= 1000; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    CuAssertTrue(tc, 1000 == hashmap_count(hm));
+    hashmap_freeall(hm);
+    free(entries);
+}
+
+void TestParallel_SmallBuilds(
+    CuTest * tc
+    )
+{
+    hashmap_entry_t *entries = __entries(5000);
+    int nthreads[] = { 1, 2, 64 };
+    size_t sizes[] = { 0, 10, 5000 };
+    unsigned int t, s;
+
+    for (t = 0; t < sizeof(nthreads) / sizeof(nthreads[0]); t++)
+        for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        {
+            hashmap_t *hm;
+            unsigned long i;
+
+            hm = hashmap_build_parallel(hashmap_uintptr_hash,
+                                        hashmap_uintptr_compare, entries,
+                                        sizes[s], nthreads[t], 0);
+            for (i = 0; i < sizes[s]; i++)
+                if (entries[i].val)
+                    CuAssertPtrNotNull(tc, hashmap_get(hm, entries[i].key));
+            hashmap_freeall(hm);
+        }
+    free(entries);
+}
+
+typedef struct
+{
+    unsigned long entries;
+    unsigned long vals;
+} sum_t;
+
+static void __sum_and_double(hashmap_entry_t * ety, void *ctx)
+{
+    sum_t *sum = ctx;
+
+    sum->entries++;
+    sum->vals += (unsigned long)ety->val;
+    ety->val = (void*)((unsigned long)ety->val * 2);
+}
+
+void TestParallel_BuildWithFarMoreThreadsThanEntries(
+    CuTest * tc
+    )
+{
+    hashmap_entry_t *entries = __entries(20000);
+    hashmap_t *hm;
+    unsigned long i;
+
+    hm = hashmap_build_parallel(hashmap_uintptr_hash, hashmap_uintptr_compare,
+                                entries, 20000, 1 << 24, 0);
+    CuAssertTrue(tc, NULL != hm);
+    /* both entries for every 1000th key are missing their value */
+    CuAssertTrue(tc, 9990 == hashmap_count(hm));
+    for (i = 10000; i < 20000; i++)
+        if (entries[i].val)
+            CuAssertTrue(tc, entries[i].val == hashmap_get(hm, entries[i].key));
+    hashmap_freeall(hm);
+    free(entries);
+}
+
+void TestParallel_ForEachVisitsEveryEntryOnce(
+    CuTest * tc
+    )
+{
+    int flags[] = { 0, HASHMAP_OPEN_ADDRESSING, HASHMAP_ORDERED,
+        HASHMAP_INLINE_BUCKETS };
+    unsigned int f;
+
+    for (f = 0; f < sizeof(flags) / sizeof(flags[0]); f++)
+    {
+        sum_t sums[4];
+        void *ctxs[4];
+        hashmap_t *hm;
+        unsigned long i, entries = 0, vals = 0;
+        int t;
+
+        hm = hashmap_new_with_flags(hashmap_uintptr_hash,
+                                    hashmap_uintptr_compare, 11, flags[f]);
+        for (i = 1; i <= 100000; i++)
+            hashmap_put(hm, (void*)i, (void*)i);
+
+        memset(sums, 0, sizeof(sums));
+        for (t = 0; t < 4; t++)
+            ctxs[t] = &sums[t];
+        hashmap_for_each_parallel(hm, __sum_and_double, ctxs, 4);
+        for (t = 0; t < 4; t++)
+        {
+            entries += sums[t].entries;
+            vals += sums[t].vals;
+        }
+        CuAssertTrue(tc, 100000 == entries);
+        CuAssertTrue(tc, 100000UL * 100001 / 2 == vals);
+        for (i = 1; i <= 100000; i++)
+            CuAssertTrue(tc, (void*)(i * 2) == hashmap_get(hm, (void*)i));
+        hashmap_freeall(hm);
+    }
+}
+
+static void __count_entry(hashmap_entry_t * ety, void *ctx)
+{
+    (void)ety;
+    (*(unsigned long*)ctx)++;
+}
+
+void TestParallel_ForEachOnSmallMaps(
+    CuTest * tc
+    )
+{
+    unsigned long counts[64];
+    void *ctxs[64];
+    hashmap_t *hm;
+    unsigned long i, total = 0;
+    int t;
+
+    hm = hashmap_new(hashmap_uintptr_hash, hashmap_uintptr_compare, 11);
+    hashmap_for_each_parallel(hm, __count_entry, NULL, 64);
+
+    for (i = 1; i <= 100; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    memset(counts, 0, sizeof(counts));
+    for (t = 0; t < 64; t++)
+        ctxs[t] = &counts[t];
+    hashmap_for_each_parallel(hm, __count_entry, ctxs, 64);
+    for (t = 0; t < 64; t++)
+        total += counts[t];
+    CuAssertTrue(tc, 100 == total);
+    hashmap_freeall(hm);
+}
@@ -0,0 +1,198 @@
+#include <stdbool.h>
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "CuTest.h"
+
+#include "sharded_hashmap.h"
+
+#define NTHREADS 4
+#define PER_THREAD 20000
+
+static unsigned long __uint_hash(
+    const void *e1
+    )
+{
+    const long i1 = (unsigned long)e1;
+
+    assert(i1 >= 0);
+    return i1;
+}
+
+static unsigned long __hash_calls;
+
+static unsigned long __counting_hash(
+    const void *e1
+    )
+{
+    __hash_calls++;
+    return (unsigned long)e1;
+}
+
+static long __uint_compare(
+    const void *e1,
+    const void *e2
+    )
+{
+    const long i1 = (unsigned long)e1, i2 = (unsigned long)e2;
+
+    return i1 - i2;
+}
+
+void TestShardedHashmap_PutGetRemove(
+    CuTest * tc
+    )
+{
+    sharded_hashmap_t *hm;
+
+    hm = sharded_hashmap_new(__uint_hash, __uint_compare, 4, 4, 0);
+    CuAssertTrue(tc, NULL == sharded_hashmap_put(hm, (void*)50, (void*)92));
+    CuAssertTrue(tc, 1 == sharded_hashmap_count(hm));
+    CuAssertTrue(tc, 92 == (unsigned long)sharded_hashmap_get(hm, (void*)50));
+    CuAssertTrue(tc, 1 == sharded_hashmap_contains_key(hm, (void*)50));
+
+    CuAssertTrue(tc, 92 ==
+                 (unsigned long)sharded_hashmap_put(hm, (void*)50, (void*)23));
+    CuAssertTrue(tc, 1 == sharded_hashmap_count(hm));
+
+    CuAssertTrue(tc, NULL == sharded_hashmap_remove(hm, (void*)51));
+    CuAssertTrue(tc, 23 == (unsigned long)sharded_hashmap_remove(hm, (void*)50));
+    CuAssertTrue(tc, 0 == sharded_hashmap_count(hm));
+    CuAssertTrue(tc, NULL == sharded_hashmap_get(hm, (void*)50));
+    sharded_hashmap_freeall(hm);
+}
+
+void TestShardedHashmap_KeysAreHashedOnce(
+    CuTest * tc
+    )
+{
+    sharded_hashmap_t *hm;
+    unsigned long i;
+
+    hm = sharded_hashmap_new(__counting_hash, __uint_compare, 64, 4, 0);
+    __hash_calls = 0;
+    for (i = 1; i <= 100; i++)
+        sharded_hashmap_put(hm, (void*)i, (void*)i);
+    for (i = 1; i <= 100; i++)
+        CuAssertTrue(tc, i == (unsigned long)sharded_hashmap_get(hm, (void*)i));
+    for (i = 1; i <= 100; i++)
+        sharded_hashmap_remove(hm, (void*)i);
+    CuAssertTrue(tc, 300 == __hash_calls);
+    sharded_hashmap_freeall(hm);
+}
+
+void TestShardedHashmap_KeysSpreadOverShards(
+    CuTest * tc
+    )
+{
+    sharded_hashmap_t *hm;
+    sharded_hashmap_stats_t stats;
+    unsigned long i;
+    size_t s, total = 0;
+
+    hm = sharded_hashmap_new(__uint_hash, __uint_compare, 4, 8, 0);
+    for (i = 1; i <= 8000; i++)
+        sharded_hashmap_put(hm, (void*)i, (void*)i);
+    CuAssertTrue(tc, 8000 == sharded_hashmap_count(hm));
+
+    for (s = 0; s < 8; s++)
+    {
+        sharded_hashmap_shard_stats(hm, s, &stats);
+        /* sequential keys still get spread out */
+        CuAssertTrue(tc, 800 < stats.count && stats.count < 1200);
+        CuAssertTrue(tc, stats.count < stats.size);
+        total += stats.count;
+    }
+    CuAssertTrue(tc, 8000 == total);
+
+    sharded_hashmap_shard_stats(hm, sharded_hashmap_shard_of(hm, (void*)7),
+                                &stats);
+    CuAssertTrue(tc, 0 < stats.count);
+    sharded_hashmap_freeall(hm);
+}
+
+void TestShardedHashmap_IteratorVisitsEveryShard(
+    CuTest * tc
+    )
+{
+    sharded_hashmap_t *hm;
+    sharded_hashmap_iterator_t iter;
+    unsigned long i, sum = 0;
+    int n = 0;
+
+    hm = sharded_hashmap_new(__uint_hash, __uint_compare, 4, 16, 0);
+
+    sharded_hashmap_iterator(hm, &iter);
+    CuAssertTrue(tc, 0 == sharded_hashmap_iterator_has_next(hm, &iter));
+
+    for (i = 1; i <= 100; i++)
+        sharded_hashmap_put(hm, (void*)i, (void*)(i * 2));
+
+    sharded_hashmap_iterator(hm, &iter);
+    while (sharded_hashmap_iterator_has_next(hm, &iter))
+    {
+        sum += (unsigned long)sharded_hashmap_iterator_next_value(hm, &iter);
+        n++;
+    }
+    CuAssertTrue(tc, 100 == n);
+    CuAssertTrue(tc, 10100 == sum);
+    CuAssertTrue(tc, NULL == sharded_hashmap_iterator_next(hm, &iter));
+
+    /* removing what we're handed doesn't upset the iterator */
+    sharded_hashmap_iterator(hm, &iter);
+    while (sharded_hashmap_iterator_has_next(hm, &iter))
+        sharded_hashmap_remove(hm, sharded_hashmap_iterator_next(hm, &iter));
+    CuAssertTrue(tc, 0 == sharded_hashmap_count(hm));
+    sharded_hashmap_freeall(hm);
+}
+
+typedef struct
+{
+    sharded_hashmap_t *hm;
+    unsigned long first;
+    int failed;
+} worker_t;
+
+static void *__putter(void *arg)
+{
+    worker_t *w = arg;
+    unsigned long i;
+
+    for (i = w->first; i < w->first + PER_THREAD; i++)
+    {
+        sharded_hashmap_put(w->hm, (void*)i, (void*)(i + 1));
+        if (i + 1 != (unsigned long)sharded_hashmap_get(w->hm, (void*)i))
+            w->failed = 1;
+    }
+    return NULL;
+}
+
+void TestShardedHashmap_LockedThreads(
+    CuTest * tc
+    )
+{
+    sharded_hashmap_t *hm;
+    pthread_t threads[NTHREADS];
+    worker_t workers[NTHREADS];
+    int t;
+
+    hm = sharded_hashmap_new(__uint_hash, __uint_compare, 4, 4,
+                             SHARDED_HASHMAP_LOCKED);
+    for (t = 0; t < NTHREADS; t++)
+    {
+        workers[t].hm = hm;
+        workers[t].first = 1 + t * PER_THREAD;
+        workers[t].failed = 0;
+        pthread_create(&threads[t], NULL, __putter, &workers[t]);
+    }
+    for (t = 0; t < NTHREADS; t++)
+    {
+        pthread_join(threads[t], NULL);
+        CuAssertTrue(tc, 0 == workers[t].failed);
+    }
+    CuAssertTrue(tc, NTHREADS * PER_THREAD == sharded_hashmap_count(hm));
+    sharded_hashmap_freeall(hm);
+}
@@ -0,0 +1,242 @@
+#include <stdbool.h>
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "CuTest.h"
+
+#include "linked_list_hashmap.h"
+#include "hashmap_hashes.h"
+#include "hashmap_snapshot.h"
+
+/**
+ * @return a fresh file name to write a snapshot to */
+static char *__tmp_path(void)
+{
+    static char path[64];
+    int fd;
+
+    strcpy(path, "/tmp/test_snapshot_XXXXXX");
+    fd = mkstemp(path);
+    assert(-1 != fd);
+    close(fd);
+    return path;
+}
+
+void TestSnapshot_StringsRoundTrip(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_snapshot_t *snap;
+    char keys[1000][16], vals[1000][16];
+    char *path = __tmp_path();
+    const char *val;
+    size_t val_len;
+    int i;
+
+    hm = hashmap_new(hashmap_str_hash, hashmap_str_compare, 11);
+    for (i = 0; i < 1000; i++)
+    {
+        sprintf(keys[i], "key%d", i);
+        sprintf(vals[i], "value%d", i * 7);
+        hashmap_put(hm, keys[i], vals[i]);
+    }
+    CuAssertTrue(tc, 0 == hashmap_snapshot_write(hm, path,
+                                                 hashmap_snapshot_encode_str,
+                                                 hashmap_snapshot_encode_str));
+    hashmap_freeall(hm);
+
+    snap = hashmap_snapshot_open(path);
+    CuAssertPtrNotNull(tc, snap);
+    CuAssertTrue(tc, 1000 == hashmap_snapshot_count(snap));
+    for (i = 0; i < 1000; i++)
+    {
+        val = hashmap_snapshot_get(snap, keys[i], strlen(keys[i]), &val_len);
+        CuAssertPtrNotNull(tc, val);
+        CuAssertTrue(tc, strlen(vals[i]) == val_len);
+        CuAssertTrue(tc, 0 == memcmp(vals[i], val, val_len));
+        CuAssertTrue(tc, 0 == (uintptr_t)val % 8);
+    }
+    CuAssertTrue(tc, NULL == hashmap_snapshot_get(snap, "key1000", 7, NULL));
+    /* a prefix of a key isn't the key */
+    CuAssertTrue(tc, NULL == hashmap_snapshot_get(snap, "key1", 3, NULL));
+    hashmap_snapshot_close(snap);
+    unlink(path);
+}
+
+void TestSnapshot_IntegersReadInPlace(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_snapshot_t *snap;
+    char *path = __tmp_path();
+    unsigned long i;
+
+    hm = hashmap_new_with_flags(hashmap_uintptr_hash, hashmap_uintptr_compare,
+                                11, HASHMAP_OPEN_ADDRESSING);
+    for (i = 1; i <= 10000; i++)
+        hashmap_put(hm, (void*)i, (void*)(i * 3));
+    CuAssertTrue(tc, 0 == hashmap_snapshot_write(
+                     hm, path, hashmap_snapshot_encode_uintptr,
+                     hashmap_snapshot_encode_uintptr));
+    hashmap_freeall(hm);
+
+    snap = hashmap_snapshot_open(path);
+    CuAssertPtrNotNull(tc, snap);
+    for (i = 1; i <= 10000; i++)
+    {
+        const unsigned long *val =
+            hashmap_snapshot_get(snap, &i, sizeof(i), NULL);
+
+        CuAssertPtrNotNull(tc, val);
+        CuAssertTrue(tc, i * 3 == *val);
+    }
+    i = 10001;
+    CuAssertTrue(tc, NULL == hashmap_snapshot_get(snap, &i, sizeof(i), NULL));
+    hashmap_snapshot_close(snap);
+    unlink(path);
+}
+
+void TestSnapshot_EmptyMap(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_snapshot_t *snap;
+    char *path = __tmp_path();
+
+    hm = hashmap_new(hashmap_str_hash, hashmap_str_compare, 11);
+    CuAssertTrue(tc, 0 == hashmap_snapshot_write(hm, path,
+                                                 hashmap_snapshot_encode_str,
+                                                 hashmap_snapshot_encode_str));
+    hashmap_freeall(hm);
+
+    snap = hashmap_snapshot_open(path);
+    CuAssertPtrNotNull(tc, snap);
+    CuAssertTrue(tc, 0 == hashmap_snapshot_count(snap));
+    CuAssertTrue(tc, NULL == hashmap_snapshot_get(snap, "a", 1, NULL));
+    hashmap_snapshot_close(snap);
+    unlink(path);
+}
+
+void TestSnapshot_RewriteLeavesOpenSnapshotAlone(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_snapshot_t *snap, *snap2;
+    char *path = __tmp_path();
+
+    hm = hashmap_new(hashmap_str_hash, hashmap_str_compare, 11);
+    hashmap_put(hm, "a", "old");
+    hashmap_snapshot_write(hm, path, hashmap_snapshot_encode_str,
+                           hashmap_snapshot_encode_str);
+    snap = hashmap_snapshot_open(path);
+    CuAssertPtrNotNull(tc, snap);
+
+    hashmap_put(hm, "a", "new");
+    hashmap_put(hm, "b", "new");
+    CuAssertTrue(tc, 0 == hashmap_snapshot_write(hm, path,
+                                                 hashmap_snapshot_encode_str,
+                                                 hashmap_snapshot_encode_str));
+    hashmap_freeall(hm);
+
+    CuAssertTrue(tc, 0 == memcmp("old", hashmap_snapshot_get(snap, "a", 1,
+                                                             NULL), 3));
+    snap2 = hashmap_snapshot_open(path);
+    CuAssertTrue(tc, 2 == hashmap_snapshot_count(snap2));
+    CuAssertTrue(tc, 0 == memcmp("new", hashmap_snapshot_get(snap2, "a", 1,
+                                                             NULL), 3));
+    hashmap_snapshot_close(snap);
+    hashmap_snapshot_close(snap2);
+    unlink(path);
+}
+
+void TestSnapshot_RejectsOtherFiles(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    char *path = __tmp_path();
+    FILE *f;
+
+    f = fopen(path, "wb");
+    fputs("not a snapshot, but long enough to hold a header", f);
+    fclose(f);
+    errno = 0;
+    CuAssertTrue(tc, NULL == hashmap_snapshot_open(path));
+    CuAssertTrue(tc, EINVAL == errno);
+
+    /* a snapshot that has been cut short */
+    hm = hashmap_new(hashmap_str_hash, hashmap_str_compare, 11);
+    hashmap_put(hm, "a", "b");
+    hashmap_snapshot_write(hm, path, hashmap_snapshot_encode_str,
+                           hashmap_snapshot_encode_str);
+    hashmap_freeall(hm);
+    CuAssertTrue(tc, 0 == truncate(path, 80));
+    CuAssertTrue(tc, NULL == hashmap_snapshot_open(path));
+    CuAssertTrue(tc, EINVAL == errno);
+
+    unlink(path);
+    CuAssertTrue(tc, NULL == hashmap_snapshot_open(path));
+    CuAssertTrue(tc, ENOENT == errno);
+}
+
+void TestSnapshot_RewriteLeavesOnlyTheSnapshot(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_snapshot_t *snap;
+    char dir[64], path[80];
+    struct dirent *de;
+    struct stat st;
+    DIR *d;
+    int files = 0;
+    unsigned long i;
+
+    strcpy(dir, "/tmp/test_snapshot_dir_XXXXXX");
+    CuAssertPtrNotNull(tc, mkdtemp(dir));
+    sprintf(path, "%s/snap", dir);
+
+    hm = hashmap_new(hashmap_uintptr_hash, hashmap_uintptr_compare, 11);
+    for (i = 1; i <= 100; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    CuAssertTrue(tc, 0 == hashmap_snapshot_write(
+                     hm, path, hashmap_snapshot_encode_uintptr,
+                     hashmap_snapshot_encode_uintptr));
+    hashmap_put(hm, (void*)101, (void*)101);
+    CuAssertTrue(tc, 0 == hashmap_snapshot_write(
+                     hm, path, hashmap_snapshot_encode_uintptr,
+                     hashmap_snapshot_encode_uintptr));
+
+    /* the temporary file went, and the snapshot isn't only ours to read */
+    d = opendir(dir);
+    while ((de = readdir(d)))
+        if ('.' != de->d_name[0])
+        {
+            CuAssertStrEquals(tc, "snap", de->d_name);
+            files++;
+        }
+    closedir(d);
+    CuAssertTrue(tc, 1 == files);
+    CuAssertTrue(tc, 0 == stat(path, &st));
+    CuAssertTrue(tc, 0 != (st.st_mode & S_IROTH));
+
+    snap = hashmap_snapshot_open(path);
+    CuAssertPtrNotNull(tc, snap);
+    CuAssertTrue(tc, 101 == hashmap_snapshot_count(snap));
+    hashmap_snapshot_close(snap);
+
+    unlink(path);
+    rmdir(dir);
+    hashmap_freeall(hm);
+}
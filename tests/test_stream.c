@@ -0,0 +1,393 @@
+#include <stdbool.h>
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "CuTest.h"
+
+#include "linked_list_hashmap.h"
+#include "hashmap_hashes.h"
+#include "hashmap_snapshot.h"
+#include "hashmap_stream.h"
+
+static void __free_strings(hashmap_t * hm)
+{
+    hashmap_iterator_t iter;
+    hashmap_entry_t *ety;
+
+    hashmap_iterator(hm, &iter);
+    while ((ety = hashmap_iterator_next_entry(hm, &iter)))
+    {
+        free((void*)ety->key);
+        free(ety->val);
+    }
+    hashmap_freeall(hm);
+}
+
+void TestStream_StringsRoundTrip(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm, *hm2;
+    char keys[10000][16], vals[10000][16];
+    FILE *f = tmpfile();
+    int i;
+
+    hm = hashmap_new(hashmap_str_hash, hashmap_str_compare, 11);
+    for (i = 0; i < 10000; i++)
+    {
+        sprintf(keys[i], "key%d", i);
+        sprintf(vals[i], "value%d", i * 7);
+        hashmap_put(hm, keys[i], vals[i]);
+    }
+    CuAssertTrue(tc, 0 == hashmap_stream_write(hm, f,
+                                               hashmap_snapshot_encode_str,
+                                               hashmap_snapshot_encode_str,
+                                               HASHMAP_STREAM_CHECKSUM));
+    hashmap_freeall(hm);
+
+    rewind(f);
+    hm2 = hashmap_new(hashmap_str_hash, hashmap_str_compare, 11);
+    CuAssertTrue(tc, 0 == hashmap_stream_read(hm2, f,
+                                              hashmap_stream_decode_str,
+                                              hashmap_stream_decode_str,
+                                              NULL));
+    CuAssertTrue(tc, 10000 == hashmap_count(hm2));
+    for (i = 0; i < 10000; i++)
+        CuAssertStrEquals(tc, vals[i], hashmap_get(hm2, keys[i]));
+    __free_strings(hm2);
+    fclose(f);
+}
+
+void TestStream_ReadingDoesntResize(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    hashmap_stats_t stats;
+    FILE *f = tmpfile();
+    unsigned long i;
+
+    hm = hashmap_new_with_flags(hashmap_uintptr_hash, hashmap_uintptr_compare,
+                                11, HASHMAP_OPEN_ADDRESSING);
+    for (i = 1; i <= 100000; i++)
+        hashmap_put(hm, (void*)i, (void*)(i * 3));
+    CuAssertTrue(tc, 0 == hashmap_stream_write(
+                     hm, f, hashmap_snapshot_encode_uintptr,
+                     hashmap_snapshot_encode_uintptr, 0));
+    hashmap_freeall(hm);
+
+    rewind(f);
+    hm = hashmap_new_with_flags(hashmap_uintptr_hash, hashmap_uintptr_compare,
+                                11, HASHMAP_OPEN_ADDRESSING);
+    CuAssertTrue(tc, 0 == hashmap_stream_read(hm, f,
+                                              hashmap_stream_decode_uintptr,
+                                              hashmap_stream_decode_uintptr,
+                                              NULL));
+    CuAssertTrue(tc, 100000 == hashmap_count(hm));
+    for (i = 1; i <= 100000; i++)
+        CuAssertTrue(tc, i * 3 == (unsigned long)hashmap_get(hm, (void*)i));
+
+    /* just the one up front */
+    hashmap_get_stats(hm, &stats);
+    CuAssertTrue(tc, 1 == stats.resizes);
+    hashmap_freeall(hm);
+    fclose(f);
+}
+
+void TestStream_EntryBiggerThanAChunk(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    FILE *f = tmpfile();
+    char *big = malloc(1 << 20);
+
+    memset(big, 'x', (1 << 20) - 1);
+    big[(1 << 20) - 1] = '\0';
+
+    hm = hashmap_new(hashmap_str_hash, hashmap_str_compare, 11);
+    hashmap_put(hm, "small", "entry");
+    hashmap_put(hm, "big", big);
+    CuAssertTrue(tc, 0 == hashmap_stream_write(hm, f,
+                                               hashmap_snapshot_encode_str,
+                                               hashmap_snapshot_encode_str,
+                                               HASHMAP_STREAM_CHECKSUM));
+    hashmap_freeall(hm);
+
+    rewind(f);
+    hm = hashmap_new(hashmap_str_hash, hashmap_str_compare, 11);
+    CuAssertTrue(tc, 0 == hashmap_stream_read(hm, f,
+                                              hashmap_stream_decode_str,
+                                              hashmap_stream_decode_str,
+                                              NULL));
+    CuAssertTrue(tc, 2 == hashmap_count(hm));
+    CuAssertStrEquals(tc, big, hashmap_get(hm, "big"));
+    CuAssertStrEquals(tc, "entry", hashmap_get(hm, "small"));
+    __free_strings(hm);
+    free(big);
+    fclose(f);
+}
+
+void TestStream_DetectsDamage(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    FILE *f = tmpfile();
+    long size;
+    unsigned long i;
+    int c;
+
+    hm = hashmap_new(hashmap_uintptr_hash, hashmap_uintptr_compare, 11);
+    for (i = 1; i <= 1000; i++)
+        hashmap_put(hm, (void*)i, (void*)i);
+    hashmap_stream_write(hm, f, hashmap_snapshot_encode_uintptr,
+                         hashmap_snapshot_encode_uintptr,
+                         HASHMAP_STREAM_CHECKSUM);
+    hashmap_freeall(hm);
+    size = ftell(f);
+
+    /* flip a bit in the middle of a value */
+    fseek(f, size / 2, SEEK_SET);
+    c = getc(f);
+    fseek(f, size / 2, SEEK_SET);
+    putc(c ^ 1, f);
+    rewind(f);
+    hm = hashmap_new(hashmap_uintptr_hash, hashmap_uintptr_compare, 11);
+    errno = 0;
+    CuAssertTrue(tc, -1 == hashmap_stream_read(hm, f,
+                                               hashmap_stream_decode_uintptr,
+                                               hashmap_stream_decode_uintptr,
+                                               NULL));
+    CuAssertTrue(tc, EBADMSG == errno);
+    hashmap_freeall(hm);
+    fclose(f);
+
+    /* cut short */
+    f = tmpfile();
+    hm = hashmap_new(hashmap_uintptr_hash, hashmap_uintptr_compare, 11);
+    hashmap_put(hm, (void*)1, (void*)1);
+    hashmap_stream_write(hm, f, hashmap_snapshot_encode_uintptr,
+                         hashmap_snapshot_encode_uintptr, 0);
+    hashmap_clear(hm);
+    fflush(f);
+    CuAssertTrue(tc, 0 == ftruncate(fileno(f), ftell(f) - 3));
+    rewind(f);
+    CuAssertTrue(tc, -1 == hashmap_stream_read(hm, f,
+                                               hashmap_stream_decode_uintptr,
+                                               hashmap_stream_decode_uintptr,
+                                               NULL));
+    CuAssertTrue(tc, EBADMSG == errno);
+    fclose(f);
+
+    /* not a stream at all */
+    f = tmpfile();
+    fputs("something else", f);
+    rewind(f);
+    CuAssertTrue(tc, -1 == hashmap_stream_read(hm, f,
+                                               hashmap_stream_decode_uintptr,
+                                               hashmap_stream_decode_uintptr,
+                                               NULL));
+    CuAssertTrue(tc, EINVAL == errno);
+    hashmap_freeall(hm);
+    fclose(f);
+}
+
+static void __write_varint(FILE * f, uint64_t v)
+{
+    for (; 0x80 <= v; v >>= 7)
+        putc((v & 0x7f) | 0x80, f);
+    putc(v, f);
+}
+
+/**
+ * Write a stream of one entry whose header claims count entries. */
+static void __write_lying_stream(FILE * f, uint64_t count)
+{
+    unsigned char key[8], val[8];
+
+    hashmap_snapshot_encode_uintptr((void*)7, key, sizeof(key));
+    hashmap_snapshot_encode_uintptr((void*)9, val, sizeof(val));
+    fwrite("HMSTRM\0\1", 1, 8, f);
+    __write_varint(f, count);
+    __write_varint(f, 0);
+    __write_varint(f, 2 + sizeof(key) + sizeof(val));
+    __write_varint(f, sizeof(key));
+    fwrite(key, 1, sizeof(key), f);
+    __write_varint(f, sizeof(val));
+    fwrite(val, 1, sizeof(val), f);
+    __write_varint(f, 0);
+}
+
+void TestStream_CountInHeaderIsNotTrusted(
+    CuTest * tc
+    )
+{
+    uint64_t counts[] = { 1000000000000ULL, 1ULL << 62, UINT64_MAX };
+    unsigned int c;
+
+    for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+        int p, fds[2];
+
+        /* once from a file, whose size we know, and once from a pipe */
+        for (p = 0; p < 2; p++)
+        {
+            hashmap_t *hm;
+            FILE *f;
+
+            if (0 == p)
+                f = tmpfile();
+            else
+            {
+                CuAssertTrue(tc, 0 == pipe(fds));
+                f = fdopen(fds[1], "wb");
+            }
+            __write_lying_stream(f, counts[c]);
+            if (0 == p)
+                rewind(f);
+            else
+            {
+                fclose(f);
+                f = fdopen(fds[0], "rb");
+            }
+
+            hm = hashmap_new(hashmap_uintptr_hash, hashmap_uintptr_compare,
+                             11);
+            CuAssertTrue(tc, 0 == hashmap_stream_read(
+                             hm, f, hashmap_stream_decode_uintptr,
+                             hashmap_stream_decode_uintptr,
+                             NULL));
+            CuAssertTrue(tc, 1 == hashmap_count(hm));
+            CuAssertTrue(tc, 9 == (unsigned long)hashmap_get(hm, (void*)7));
+            CuAssertTrue(tc, hashmap_size(hm) < 1024);
+            hashmap_freeall(hm);
+            fclose(f);
+        }
+    }
+}
+
+static int __released;
+
+static void __release_strings(void *key, void *val)
+{
+    free(key);
+    free(val);
+    __released++;
+}
+
+static void *__decode_str_unless_bad(const void *data, size_t len)
+{
+    if (3 == len && !memcmp(data, "bad", 3))
+        return NULL;
+    return hashmap_stream_decode_str(data, len);
+}
+
+void TestStream_ReleasesWhatTheMapDoesntKeep(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm;
+    FILE *f = tmpfile();
+
+    hm = hashmap_new(hashmap_str_hash, hashmap_str_compare, 11);
+    hashmap_put(hm, "a", "1");
+    hashmap_put(hm, "b", "2");
+    hashmap_stream_write(hm, f, hashmap_snapshot_encode_str,
+                         hashmap_snapshot_encode_str,
+                         HASHMAP_STREAM_CHECKSUM);
+    hashmap_freeall(hm);
+
+    /* "a" is already there, so its old value and the new key come back */
+    rewind(f);
+    hm = hashmap_new(hashmap_str_hash, hashmap_str_compare, 11);
+    hashmap_put(hm, strdup("a"), strdup("old"));
+    __released = 0;
+    CuAssertTrue(tc, 0 == hashmap_stream_read(hm, f,
+                                              hashmap_stream_decode_str,
+                                              hashmap_stream_decode_str,
+                                              __release_strings));
+    CuAssertTrue(tc, 1 == __released);
+    CuAssertTrue(tc, 2 == hashmap_count(hm));
+    CuAssertStrEquals(tc, "1", hashmap_get(hm, "a"));
+    CuAssertStrEquals(tc, "2", hashmap_get(hm, "b"));
+    __free_strings(hm);
+    fclose(f);
+
+    /* a key whose value doesn't decode comes back on its own */
+    f = tmpfile();
+    hm = hashmap_new(hashmap_str_hash, hashmap_str_compare, 11);
+    hashmap_put(hm, "k", "bad");
+    hashmap_stream_write(hm, f, hashmap_snapshot_encode_str,
+                         hashmap_snapshot_encode_str,
+                         HASHMAP_STREAM_CHECKSUM);
+    hashmap_freeall(hm);
+
+    rewind(f);
+    hm = hashmap_new(hashmap_str_hash, hashmap_str_compare, 11);
+    __released = 0;
+    errno = 0;
+    CuAssertTrue(tc, -1 == hashmap_stream_read(hm, f,
+                                               hashmap_stream_decode_str,
+                                               __decode_str_unless_bad,
+                                               __release_strings));
+    CuAssertTrue(tc, EBADMSG == errno);
+    CuAssertTrue(tc, 1 == __released);
+    CuAssertTrue(tc, 0 == hashmap_count(hm));
+    hashmap_freeall(hm);
+    fclose(f);
+}
+
+void TestStream_ReadingFromAPipeResizesLikePutting(
+    CuTest * tc
+    )
+{
+    hashmap_t *hm, *hm_put;
+    hashmap_stats_t stats, stats_put;
+    FILE *f;
+    int fds[2];
+    pid_t pid;
+    unsigned long i;
+
+    /* a pipe has no size to check the count against */
+    CuAssertTrue(tc, 0 == pipe(fds));
+    if (0 == (pid = fork()))
+    {
+        close(fds[0]);
+        f = fdopen(fds[1], "wb");
+        hm = hashmap_new(hashmap_uintptr_hash, hashmap_uintptr_compare, 11);
+        for (i = 1; i <= 500000; i++)
+            hashmap_put(hm, (void*)i, (void*)i);
+        hashmap_stream_write(hm, f, hashmap_snapshot_encode_uintptr,
+                             hashmap_snapshot_encode_uintptr, 0);
+        fclose(f);
+        _exit(0);
+    }
+    close(fds[1]);
+    f = fdopen(fds[0], "rb");
+
+    hm = hashmap_new(hashmap_uintptr_hash, hashmap_uintptr_compare, 11);
+    CuAssertTrue(tc, 0 == hashmap_stream_read(hm, f,
+                                              hashmap_stream_decode_uintptr,
+                                              hashmap_stream_decode_uintptr,
+                                              NULL));
+    fclose(f);
+    waitpid(pid, NULL, 0);
+    CuAssertTrue(tc, 500000 == hashmap_count(hm));
+
+    hm_put = hashmap_new(hashmap_uintptr_hash, hashmap_uintptr_compare, 11);
+    for (i = 1; i <= 500000; i++)
+        hashmap_put(hm_put, (void*)i, (void*)i);
+    hashmap_get_stats(hm, &stats);
+    hashmap_get_stats(hm_put, &stats_put);
+    CuAssertTrue(tc, 0 < stats.resizes);
+    CuAssertTrue(tc, stats.resizes <= stats_put.resizes);
+    hashmap_freeall(hm);
+    hashmap_freeall(hm_put);
+}
@@ -0,0 +1,133 @@
+#include <stdbool.h>
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "CuTest.h"
+
+#include "hashmap_template.h"
+#include "hashmap_hashes.h"
+
+HASHMAP_INIT(u64map, uint64_t, uint64_t, hashmap_tpl_hash_u64, HASHMAP_TPL_EQ)
+
+#define __STR_EQ(a, b) (0 == strcmp((a), (b)))
+
+HASHMAP_INIT(strmap, const char *, int, hashmap_str_hash, __STR_EQ)
+
+void TestHashmapTemplate_PutGetRemove(
+    CuTest * tc
+    )
+{
+    u64map_t *hm;
+    uint64_t val = 0;
+
+    hm = u64map_new(0);
+    CuAssertTrue(tc, 1 == u64map_put(hm, 50, 92));
+    CuAssertTrue(tc, 0 == u64map_put(hm, 50, 23));
+    CuAssertTrue(tc, 1 == u64map_count(hm));
+    CuAssertTrue(tc, 23 == *u64map_get(hm, 50));
+    CuAssertTrue(tc, NULL == u64map_get(hm, 51));
+
+    CuAssertTrue(tc, 0 == u64map_remove(hm, 51, &val));
+    CuAssertTrue(tc, 1 == u64map_remove(hm, 50, &val));
+    CuAssertTrue(tc, 23 == val);
+    CuAssertTrue(tc, 0 == u64map_count(hm));
+    CuAssertTrue(tc, NULL == u64map_get(hm, 50));
+    u64map_freeall(hm);
+}
+
+void TestHashmapTemplate_ZeroIsAKeyAndAValue(
+    CuTest * tc
+    )
+{
+    u64map_t *hm;
+
+    hm = u64map_new(0);
+    CuAssertTrue(tc, NULL == u64map_get(hm, 0));
+    CuAssertTrue(tc, 1 == u64map_put(hm, 0, 0));
+    CuAssertTrue(tc, NULL != u64map_get(hm, 0));
+    CuAssertTrue(tc, 0 == *u64map_get(hm, 0));
+    CuAssertTrue(tc, 1 == u64map_remove(hm, 0, NULL));
+    CuAssertTrue(tc, NULL == u64map_get(hm, 0));
+    u64map_freeall(hm);
+}
+
+void TestHashmapTemplate_ManyKeysWithChurn(
+    CuTest * tc
+    )
+{
+    u64map_t *hm;
+    uint64_t i;
+    size_t size = 0;
+
+    hm = u64map_new(0);
+    for (i = 0; i < 90000; i++)
+        u64map_put(hm, i * 4096, i);
+    CuAssertTrue(tc, 90000 == u64map_count(hm));
+    for (i = 0; i < 90000; i++)
+        CuAssertTrue(tc, i == *u64map_get(hm, i * 4096));
+
+    /* tombstones get swept out instead of growing the table forever */
+    for (i = 0; i < 900000; i++)
+    {
+        if (450000 == i)
+            size = hm->size;
+        u64map_remove(hm, i * 4096, NULL);
+        u64map_put(hm, (i + 90000) * 4096, i);
+    }
+    CuAssertTrue(tc, 90000 == u64map_count(hm));
+    CuAssertTrue(tc, size == hm->size);
+    CuAssertTrue(tc, 899999 == *u64map_get(hm, 989999ULL * 4096));
+    u64map_freeall(hm);
+}
+
+void TestHashmapTemplate_IterateAndRemove(
+    CuTest * tc
+    )
+{
+    u64map_t *hm;
+    u64map_iterator_t iter;
+    uint64_t i, key, val, sum = 0;
+
+    hm = u64map_new(0);
+    u64map_reserve(hm, 1000);
+    for (i = 0; i < 1000; i++)
+        u64map_put(hm, i, i * 2);
+
+    u64map_iterator(hm, &iter);
+    while (u64map_iterator_next(hm, &iter, &key, &val))
+    {
+        CuAssertTrue(tc, key * 2 == val);
+        sum += key;
+        CuAssertTrue(tc, 1 == u64map_remove(hm, key, NULL));
+    }
+    CuAssertTrue(tc, 499500 == sum);
+    CuAssertTrue(tc, 0 == u64map_count(hm));
+    u64map_freeall(hm);
+}
+
+void TestHashmapTemplate_StringKeys(
+    CuTest * tc
+    )
+{
+    strmap_t *hm;
+    char keys[100][16], probe[16];
+    int i;
+
+    hm = strmap_new(0);
+    for (i = 0; i < 100; i++)
+    {
+        snprintf(keys[i], sizeof(keys[i]), "key:%d", i);
+        strmap_put(hm, keys[i], i);
+    }
+    for (i = 0; i < 100; i++)
+    {
+        snprintf(probe, sizeof(probe), "key:%d", i);
+        CuAssertTrue(tc, i == *strmap_get(hm, probe));
+    }
+    strmap_clear(hm);
+    CuAssertTrue(tc, NULL == strmap_get(hm, "key:1"));
+    strmap_freeall(hm);
+}